@@ -0,0 +1,70 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <glob.h>
+#include <string.h>
+
+#include "common.h"
+#include "kernel.h"
+#include "processes.h"
+#include "stats.h"
+
+/* Files filtered at the same time by a batch: the next file is read while the previous one is filtered and
+   written, and the strips in flight stay bounded to the ones of this many files */
+#define BATCH_FILES_IN_FLIGHT 2
+
+/* Define struct to store the files of a batch */
+typedef struct batch
+{
+    char** inputs;      // Input file paths
+    char** outputs;     // Output file paths, one per input
+    int count;          // Number of files
+} batch;
+
+/**
+ * @brief Load a batch from a manifest file: one input path and one output path per line, separated by spaces
+ *        and quoted if they contain spaces. Empty lines and lines starting with # are ignored.
+ *
+ * @param path The path of the manifest file.
+ *
+ * @return batch* The batch, or NULL if the manifest can not be read or has an invalid line.
+*/
+batch* batch_load_manifest(const char* path);
+
+/**
+ * @brief Load a batch from a glob pattern: every matching file, in sorted order, is written to the output
+ *        directory with its own file name.
+ *
+ * @param pattern The glob pattern of the input files.
+ * @param output_dir The directory of the output files.
+ *
+ * @return batch* The batch, or NULL if no file matches the pattern.
+*/
+batch* batch_load_glob(const char* pattern, const char* output_dir);
+
+/**
+ * @brief Free the memory of a batch.
+ *
+ * @param jobs The batch to free.
+ *
+ * @return void.
+*/
+void batch_free(batch* jobs);
+
+/**
+ * @brief Filter the files of a batch in one process. On parallel builds the files are tasks of a single
+ *        parallel region, BATCH_FILES_IN_FLIGHT at a time, so the threads move to the chunks of the next
+ *        file as soon as the chunks of the current one run out instead of waiting at each file boundary.
+ *        On MPI builds the files are dealt to the ranks in turn, each rank filtering whole files. The time
+ *        of each file and the throughput of the batch are printed.
+ *
+ * @param jobs The files to filter.
+ * @param kern The kernel to be applied.
+ * @param options The processing options.
+ * @param failures The number of files that could not be filtered, on every rank.
+ *
+ * @return double The time taken to filter every file, of the slowest rank on MPI builds.
+*/
+double batch_process(const batch* jobs, const kernel* kern, const process_options* options, int* failures);
+
+#endif // __BATCH_H__
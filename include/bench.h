@@ -0,0 +1,38 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <math.h>
+#include <string.h>
+
+#include "common.h"
+#include "kernel.h"
+#include "processes.h"
+#include "stats.h"
+
+/* Define struct to store the options of the benchmark */
+typedef struct bench_options
+{
+    int iterations;         // Timed runs for each thread count
+    int warmup;             // Untimed runs before the timed ones, to warm the caches and the thread pool
+    int* threads;           // Thread counts to sweep (NULL to only run with the default thread count)
+    int threads_count;      // Number of thread counts to sweep
+    const char* json_path;  // File to write the results to as JSON (NULL to only print them)
+    const char* filter;     // Name of the kernel or chain, reported with the results
+} bench_options;
+
+/**
+ * @brief Benchmark the filtering of a file: for each thread count, run the warmup runs, then the timed
+ *        runs, and report the median, 95th percentile, mean, standard deviation, minimum and maximum of
+ *        their times, with the busy time of each stage and the scaling against the first thread count.
+ *
+ * @param input_path The input file path.
+ * @param output_path The output file path, written by every run.
+ * @param kern The kernel to be applied.
+ * @param options The processing options.
+ * @param bench The options of the benchmark.
+ *
+ * @return int 0 on success, -1 if the results can not be written.
+*/
+int bench(const char* input_path, const char* output_path, const kernel* kern, const process_options* options, const bench_options* bench);
+
+#endif // __BENCH_H__
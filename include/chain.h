@@ -0,0 +1,102 @@
+#ifndef __CHAIN_H__
+#define __CHAIN_H__
+
+#include <math.h>
+#include <string.h>
+
+#include "common.h"
+#include "convolve.h"
+#include "kernel.h"
+#include "processes.h"
+#include "strips.h"
+
+/* Define the pointwise operations of a filter chain */
+typedef enum chain_op_type
+{
+    CHAIN_ABS,          // |v|
+    CHAIN_SCALE,        // v * first
+    CHAIN_OFFSET,       // v + first
+    CHAIN_THRESHOLD,    // second if v >= first, 0 otherwise
+    CHAIN_CLAMP         // v clamped to [first, second]
+} chain_op_type;
+
+/* Define struct to store a pointwise operation of a filter chain */
+typedef struct chain_op
+{
+    chain_op_type type; // The operation
+    float first;        // First parameter of the operation
+    float second;       // Second parameter of the operation
+} chain_op;
+
+/* Define struct to store a stage of a filter chain: the rows of a stage are the rows of the previous
+   stage convolved by its kernel, then transformed by its pointwise operations. The first stage has
+   no kernel, its rows are the input rows. */
+typedef struct chain_stage
+{
+    kernel* kern;       // Kernel applied to the rows of the previous stage (NULL for the first stage)
+    chain_op* ops;      // Pointwise operations applied in order to each row of the stage
+    int ops_count;      // Number of pointwise operations
+} chain_stage;
+
+/* Define struct to store a filter chain: kernels and pointwise operations applied in one pass */
+typedef struct chain
+{
+    chain_stage* stages;    // The stages, the first one holds the input rows
+    int count;              // Number of stages
+    int radius;             // Halo rows and columns of the whole chain, the sum of the kernel radii
+} chain;
+
+/**
+ * @brief Load a filter chain from a list of steps separated by commas, or from a file holding the steps
+ *        separated by commas or new lines (lines starting with '#' are ignored). A step is a kernel
+ *        name or file, as --kernel takes, or a pointwise operation: abs, scale:<factor>, offset:<value>,
+ *        threshold:<value>[:<high>] (high is 255 by default) or clamp:<low>:<high>.
+ *
+ * @param text The steps or the path of the file holding them.
+ *
+ * @return chain The loaded chain or NULL on error.
+*/
+chain* chain_load(const char* text);
+
+/**
+ * @brief Free memory of a filter chain and its kernels.
+ *
+ * @param ch The chain to free.
+ *
+ * @return void.
+*/
+void chain_free(chain* ch);
+
+/**
+ * @brief Get the number of bytes of each column of the rolling windows of a chain, used to size the tiles.
+ *
+ * @param ch The chain.
+ *
+ * @return int The bytes of all the rolling windows for one column.
+*/
+int chain_get_column_bytes(const chain* ch);
+
+/**
+ * @brief Run a filter chain on a tile of a chunk of rows, quantizing the last stage to the output type
+ *        of the options. Each stage keeps a rolling window of the rows the next kernel needs, so the
+ *        intermediate rows never leave the tile. The input rows from first_row - ch->radius to
+ *        last_row - 1 + ch->radius (clamped to the image) must be in the input buffer.
+ *
+ * @param ch The chain to run.
+ * @param input_rows The input rows, x_size pixels each, from input_first_row.
+ * @param input_first_row The index of the first row of the input buffer.
+ * @param output_rows The output rows, x_size pixels each, from first_row.
+ * @param x_size The width of the rows.
+ * @param y_size The height of the image.
+ * @param type The data type of the input rows.
+ * @param options The processing options.
+ * @param first_row The first row of the tile.
+ * @param last_row The row after the last one of the tile.
+ * @param first_column The first column of the tile.
+ * @param last_column The column after the last one of the tile.
+ *
+ * @return void.
+*/
+void chain_filter(const chain* ch, const void* input_rows, int input_first_row, void* output_rows, int x_size, int y_size, GDALDataType type, const process_options* options, int first_row, int last_row, int first_column, int last_column);
+
+#endif // __CHAIN_H__
@@ -5,14 +5,19 @@
 #include <unistd.h>
 #include <gdal.h>
 #include <cpl_conv.h>
+#include <cpl_string.h>
 
 /* Defining this macro the program is compiled with the parallel filtering algorithm.
    Otherwise, the program is compiled with the sequential filtering algorithm. */
 #define PARALLEL_PROCESSING
 
-/* Defining this macro the program is compiled with the test mode and define number of test to execute.
-   Otherwise, the program is compiled with the normal mode. */
-//#define TEST 3
+/* Minimum number of rows moved on each GDALRasterIO call. The real chunk height is this value rounded up
+   to a multiple of the band native block height, so every read and write covers whole blocks. */
+#define IO_CHUNK_MIN_ROWS 64
+
+/* Bytes of cache the tile engine sizes its tiles to: the input rows of the kernel, converted to floats if
+   needed, and the row of sums of a tile fit in it, so each input row is loaded once for all its uses. */
+#define TILE_CACHE_BYTES (32 * 1024)
 
 /* Definig this macro the program is compiled with debug mensagges on write file. */
 //#define WRITE_PRINTS
@@ -23,6 +28,15 @@
 /* Definig this macro the program is compiled with debug mensagges on filter. */
 //#define FILTER_PRINTS
 
+/* The lab4_mpi target defines MPI_PROCESSING: the rows of the image are then split in slabs, one per MPI
+   rank, and each rank filters its slab with the algorithm selected above. */
+#ifdef MPI_PROCESSING
+    #include <mpi.h>
+#endif
+
+/* The lab4_library target defines LIBRARY_BUILD: the engine is then built as a shared library, without the
+   command line program, for other programs to filter images in their memory (see lab4.h). */
+
 #ifdef PARALLEL_PROCESSING
     #include <omp.h>
 #else
@@ -0,0 +1,92 @@
+#ifndef __CONVOLVE_H__
+#define __CONVOLVE_H__
+
+#include <math.h>
+
+#include "common.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+
+    /* Define to build the SSE4.2, AVX2 and AVX-512 convolutions selected at runtime */
+    #define CONVOLVE_X86
+#endif
+
+/* Define the type of the convolution of a block of rows by a block of weights */
+typedef void (*convolve_function)(const float* const* rows, const float* weights, int rows_count, int columns_count, float* output, int width);
+
+/* Define the type of the convolution of a block of integer rows by a block of integer weights */
+typedef void (*convolve_integer_function)(const void* const* rows, GDALDataType type, const int* weights, int bound, int rows_count, int columns_count, int* output, int width);
+
+/* Define the type of the quantization of a row of sums to the output data type */
+typedef void (*quantize_function)(const void* sums, GDALDataType sum_type, float scale, float offset, void* output, GDALDataType output_type, int width);
+
+/**
+ * @brief Select the convolution for the instruction set of the CPU.
+ * 
+ * @param isa The instruction set to use (scalar, sse4.2, avx2 or avx512) or NULL to pick the best one supported.
+ * 
+ * @return int 0 on success, -1 if the instruction set is unknown or not supported by the CPU.
+*/
+int convolve_init(const char* isa);
+
+/**
+ * @brief Get the name of the instruction set used by the convolution.
+ * 
+ * @return const char* The name of the instruction set.
+*/
+const char* convolve_get_isa(void);
+
+/**
+ * @brief Convolve a block of rows_count rows by a block of rows_count * columns_count weights:
+ *        output[x] = sum of weights[i][j] * rows[i][x + j - columns_count / 2]. Columns outside
+ *        the rows are clamped to the edges. Every instruction set adds the taps in the same order,
+ *        so they all give the same result.
+ * 
+ * @param rows The rows_count input rows of width floats.
+ * @param weights The weights, row major.
+ * @param rows_count The number of rows of the weights.
+ * @param columns_count The number of columns of the weights (must be odd).
+ * @param output The output row of width floats.
+ * @param width The width of the rows.
+ * 
+ * @return void.
+*/
+void convolve(const float* const* rows, const float* weights, int rows_count, int columns_count, float* output, int width);
+
+/**
+ * @brief Convolve a block of integer rows by a block of integer weights as convolve does, with integer sums.
+ *        Byte rows are summed on 16 bits when the weights can not overflow them, other rows on 32 bits.
+ * 
+ * @param rows The rows_count input rows of width pixels.
+ * @param type The data type of the rows (GDT_Byte, GDT_UInt16 or GDT_Int16).
+ * @param weights The integer weights, row major.
+ * @param bound The sum of the absolute weights.
+ * @param rows_count The number of rows of the weights.
+ * @param columns_count The number of columns of the weights (must be odd).
+ * @param output The output row of width integers.
+ * @param width The width of the rows.
+ * 
+ * @return void.
+*/
+void convolve_integer(const void* const* rows, GDALDataType type, const int* weights, int bound, int rows_count, int columns_count, int* output, int width);
+
+/**
+ * @brief Quantize a row of sums to the output data type: output[x] = sums[x] * scale + offset, rounded halfway
+ *        away from zero and saturated to the range of integer types (NaN goes to the lowest value).
+ *        Float32 output is scaled and offset, without rounding or saturation. The output row may be the row
+ *        of sums when both are Float32.
+ * 
+ * @param sums The row of sums.
+ * @param sum_type The data type of the sums (GDT_Int32 or GDT_Float32).
+ * @param scale The scale applied to the sums.
+ * @param offset The offset added after the scale.
+ * @param output The output row of width pixels.
+ * @param output_type The data type of the output row (GDT_Byte, GDT_UInt16, GDT_Int16 or GDT_Float32).
+ * @param width The width of the rows.
+ * 
+ * @return void.
+*/
+void quantize(const void* sums, GDALDataType sum_type, float scale, float offset, void* output, GDALDataType output_type, int width);
+
+#endif // __CONVOLVE_H__
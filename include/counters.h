@@ -0,0 +1,66 @@
+#ifndef __COUNTERS_H__
+#define __COUNTERS_H__
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+#endif
+
+#include "common.h"
+#include "stats.h"
+
+/* Define the hardware events counted around each stage */
+typedef enum counters_event
+{
+    COUNTER_CYCLES,         // CPU cycles
+    COUNTER_INSTRUCTIONS,   // Retired instructions
+    COUNTER_LLC_MISSES,     // Last level cache misses
+    COUNTER_BRANCH_MISSES,  // Mispredicted branches
+    COUNTER_COUNT           // Number of events
+} counters_event;
+
+/**
+ * @brief Start counting the hardware events of the stages. Each thread opens its own group of counters on
+ *        its first timed work, counting only its user space work, so the stages are counted per thread
+ *        without any lock. On systems without perf_event_open, or when it is not allowed, nothing is
+ *        counted and the report says so.
+ *
+ * @return void.
+*/
+void counters_enable(void);
+
+/**
+ * @brief Take a snapshot of the counters of the calling thread at the start of a timed work.
+ *
+ * @return void.
+*/
+void counters_start(void);
+
+/**
+ * @brief Add the events counted by the calling thread since its snapshot to a stage.
+ *
+ * @param stage The stage of the work.
+ *
+ * @return void.
+*/
+void counters_add(process_stage stage);
+
+/**
+ * @brief Print the events of each stage next to the timing report: cycles, instructions, instructions per
+ *        cycle, and the cache and branch misses per pixel. On MPI builds the events of every rank are summed
+ *        and printed by rank 0. The counters of the threads are then closed.
+ *
+ * @param file The file to print to.
+ * @param pixels The number of pixels filtered on this rank.
+ *
+ * @return void.
+*/
+void counters_print(FILE* file, unsigned long long pixels);
+
+#endif // __COUNTERS_H__
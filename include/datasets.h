@@ -0,0 +1,96 @@
+#ifndef __DATASETS_H__
+#define __DATASETS_H__
+
+#include <strings.h>
+
+#include "common.h"
+#include "stats.h"
+
+#ifdef PARALLEL_PROCESSING
+    /* Define struct to store a pool of handles on the same dataset. GDAL handles are not thread safe, so
+       each thread uses its own handle, opened on the file of the dataset. When the handles can not be
+       opened all the threads share the dataset of the caller behind a lock. */
+    typedef struct dataset_pool
+    {
+        GDALDatasetH* handles;  // One handle per thread, the first one is the dataset of the caller
+        int count;              // Number of handles
+        int shared;             // Do all the threads share the first handle ?
+        omp_lock_t mutex;       // Lock of the first handle when it is shared
+    } dataset_pool;
+
+    /**
+     * @brief Allocate a pool of handles on a dataset, one per thread of the parallel regions.
+     * 
+     * @param dataset The dataset, used by the first thread.
+     * @param access The access to open the other handles with.
+     * @param shared Force all the threads to share the dataset behind a lock.
+     * 
+     * @return dataset_pool The allocated pool.
+    */
+    dataset_pool* dataset_pool_open(GDALDatasetH dataset, GDALAccess access, int shared);
+
+    /**
+     * @brief Close the handles opened by a pool and free its memory. The dataset of the caller is not closed.
+     * 
+     * @param pool The pool to free.
+     * 
+     * @return void.
+    */
+    void dataset_pool_close(dataset_pool* pool);
+
+    /**
+     * @brief Get the handle of the calling thread, locking it if it is shared. Must be paired with dataset_pool_release.
+     * 
+     * @param pool The pool to get the handle from.
+     * 
+     * @return GDALDatasetH The handle.
+    */
+    GDALDatasetH dataset_pool_acquire(dataset_pool* pool);
+
+    /**
+     * @brief Give back the handle of the calling thread.
+     * 
+     * @param pool The pool the handle was acquired from.
+     * 
+     * @return void.
+    */
+    void dataset_pool_release(dataset_pool* pool);
+#endif
+
+/**
+ * @brief Check if several handles can write disjoint blocks of a dataset at the same time: its blocks must
+ *        keep their size when rewritten, which uncompressed blocks do. The blocks must also be allocated
+ *        already, so a new dataset has to be closed and opened again in update mode first.
+ * 
+ * @param dataset The dataset to check.
+ * 
+ * @return int 1 if the blocks can be rewritten concurrently, 0 otherwise.
+*/
+int dataset_supports_block_rewrite(GDALDatasetH dataset);
+
+/**
+ * @brief Check if the write tasks of the bands can each use their own handle on a dataset: its blocks must be
+ *        rewritable concurrently, and hold a single band, as band interleaved GeoTIFF blocks do. The blocks
+ *        of a pixel interleaved dataset hold every band, so the handles would rewrite each other's bands.
+ * 
+ * @param dataset The dataset to check.
+ * 
+ * @return int 1 if the bands can be written concurrently, 0 otherwise.
+*/
+int dataset_supports_parallel_write(GDALDatasetH dataset);
+
+/**
+ * @brief Map a band of a dataset in memory so its rows can be read in place. The pixels of a row must be
+ *        contiguous and of the given data type, which raw files such as uncompressed band interleaved
+ *        GeoTIFF or ENVI files give when their byte order is the one of the CPU.
+ * 
+ * @param dataset The dataset to map.
+ * @param band_index The index of the band to map.
+ * @param type The data type the rows are read with.
+ * @param line_space The number of bytes between the start of two rows of the mapping.
+ * 
+ * @return CPLVirtualMem* The mapping, to free with CPLVirtualMemFree, or NULL if the band can not be mapped.
+*/
+CPLVirtualMem* dataset_map_band(GDALDatasetH dataset, int band_index, GDALDataType type, size_t* line_space);
+
+#endif // __DATASETS_H__
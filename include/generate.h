@@ -0,0 +1,48 @@
+#ifndef __GENERATE_H__
+#define __GENERATE_H__
+
+#include <stdint.h>
+
+#include "common.h"
+#include "processes.h"
+
+/* Define struct to store the shape and content of a synthetic raster */
+typedef struct generate_options
+{
+    int x_size;         // Width of the raster
+    int y_size;         // Height of the raster
+    int bands;          // Number of bands
+    GDALDataType type;  // Data type of the bands (Byte, UInt16, Int16 or Float32)
+    uint32_t seed;      // Seed of the noise, the same seed always gives the same pixels
+} generate_options;
+
+/**
+ * @brief Get the value of a pixel of a synthetic raster, in [0, 1): a diagonal gradient, squares of 64 pixels
+ *        that alternate between the bands and give sharp edges, and a hashed noise. The value only depends
+ *        on the position, the band and the seed, so it is the same on every machine and thread count.
+ *
+ * @param x The column of the pixel.
+ * @param y The row of the pixel.
+ * @param band The band of the pixel, from 0.
+ * @param x_size The width of the raster.
+ * @param y_size The height of the raster.
+ * @param seed The seed of the noise.
+ *
+ * @return double The value of the pixel.
+*/
+double generate_value(int x, int y, int band, int x_size, int y_size, uint32_t seed);
+
+/**
+ * @brief Create a GeoTIFF with synthetic content, writing it by chunks of whole blocks, so rasters of any size
+ *        are generated with the memory of a few chunks. The values of generate_value are scaled to the full
+ *        range of integer types, and to [0, 255) for Float32.
+ *
+ * @param output_path The path of the GeoTIFF to create.
+ * @param generate The shape and content of the raster.
+ * @param create_options The GTiff creation options (layout, compression, BigTIFF).
+ *
+ * @return double The time taken to generate the raster, or a negative value on error.
+*/
+double generate_file(const char* output_path, const generate_options* generate, char** create_options);
+
+#endif // __GENERATE_H__
@@ -0,0 +1,54 @@
+#ifndef __KERNEL_H__
+#define __KERNEL_H__
+
+#include <ctype.h>
+#include <math.h>
+
+#include "common.h"
+
+/* Define struct to store a square convolution kernel of odd size. Weights are stored row major and
+   applied as a correlation: weight [i][j] multiplies the pixel i - radius rows and j - radius columns
+   away from the output pixel. */
+typedef struct kernel
+{
+    int size;       // Width and height of the kernel (always odd)
+    int radius;     // Number of halo rows and columns needed on each side (size / 2)
+    float* weights; // size * size weights, row major
+    int separable;  // Is the kernel the outer product of a column and a row vector ?
+    float* column;  // size weights of the column vector (only if separable)
+    float* row;     // size weights of the row vector (only if separable)
+    int* integers;  // size * size integer weights (NULL if any weight is not an integer)
+    int bound;      // Sum of the absolute integer weights, bounds the integer sums
+} kernel;
+
+/**
+ * @brief Allocate a kernel from its weights and detect if it is separable.
+ * 
+ * @param size The width and height of the kernel (must be odd).
+ * @param weights The size * size weights, row major.
+ * 
+ * @return kernel The allocated kernel or NULL if the size is not valid.
+*/
+kernel* kernel_alloc(int size, const float* weights);
+
+/**
+ * @brief Load a kernel from a built-in name (edge, sobel, gaussian5, box7) or from a text file.
+ *        The file holds the size, the size * size weights row by row and optionally a divisor
+ *        applied to all the weights, separated by blanks. Lines starting with '#' are ignored.
+ * 
+ * @param name The built-in name or the file path.
+ * 
+ * @return kernel The loaded kernel or NULL on error.
+*/
+kernel* kernel_load(const char* name);
+
+/**
+ * @brief Free memory of a kernel.
+ * 
+ * @param kern The kernel to free.
+ * 
+ * @return void.
+*/
+void kernel_free(kernel* kern);
+
+#endif // __KERNEL_H__
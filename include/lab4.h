@@ -0,0 +1,117 @@
+#ifndef __LAB4_H__
+#define __LAB4_H__
+
+/* Public interface of the lab4 shared library: the filtering engine of the lab4 program, applied to images
+   held in the memory of the caller or opened by the caller, without files. Only this header and the GDAL
+   headers are needed to use it. */
+
+#include <gdal.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The library is built with hidden symbols, only the functions marked with LAB4_API are exported */
+#ifdef __GNUC__
+    #define LAB4_API __attribute__((visibility("default")))
+#else
+    #define LAB4_API
+#endif
+
+/* Define struct to describe an image in the memory of the caller */
+typedef struct lab4_buffer
+{
+    void* data;                 // First pixel of the first band
+    GDALDataType type;          // Data type of the pixels
+    int x_size;                 // Width of the image
+    int y_size;                 // Height of the image
+    int bands;                  // Number of bands
+    GSpacing pixel_space;       // Bytes between two pixels of a row, 0 for the size of the type
+    GSpacing line_space;        // Bytes between two rows of a band, 0 for x_size * pixel_space
+    GSpacing band_space;        // Bytes between two bands, 0 for y_size * line_space
+} lab4_buffer;
+
+/* Define struct to store the options of a filter */
+typedef struct lab4_options
+{
+    const char* kernel;         // Kernel name or file, as --kernel takes (NULL for edge)
+    const char* chain;          // Filter chain, as --chain takes, applied instead of the kernel (NULL for none)
+    float scale;                // Scale applied to the kernel sums before rounding and saturation
+    float offset;               // Offset added to the scaled sums
+    int tile_width;             // Columns of the tiles, 0 to size them to the cache
+} lab4_options;
+
+/* Filter loaded once and applied to any number of images */
+typedef struct lab4_filter lab4_filter;
+
+/**
+ * @brief Register the GDAL drivers and choose the instruction set of the convolution. Must be called once
+ *        before the other functions.
+ *
+ * @param isa The instruction set, as --simd takes: auto or NULL for the best one the CPU supports, avx512, avx2, sse4.2 or scalar.
+ *
+ * @return int 0 on success, -1 if the instruction set is unknown or not supported by the CPU.
+*/
+LAB4_API int lab4_init(const char* isa);
+
+/**
+ * @brief Set the default options: the edge kernel, no chain, a scale of 1 and an offset of 0.
+ *
+ * @param options The options to set.
+ *
+ * @return void.
+*/
+LAB4_API void lab4_options_default(lab4_options* options);
+
+/**
+ * @brief Load the kernel or the chain of a filter.
+ *
+ * @param options The options of the filter.
+ *
+ * @return lab4_filter* The filter, or NULL if its kernel or chain can not be loaded.
+*/
+LAB4_API lab4_filter* lab4_filter_create(const lab4_options* options);
+
+/**
+ * @brief Free a filter.
+ *
+ * @param filter The filter to free.
+ *
+ * @return void.
+*/
+LAB4_API void lab4_filter_destroy(lab4_filter* filter);
+
+/**
+ * @brief Filter an image in memory into another one of the same size and band count, with the tile engine
+ *        on the OpenMP threads of the caller. The output pixels are rounded and saturated to the output
+ *        type: Byte, UInt16, Int16 or Float32. When the pixels of each row are contiguous, the rows of a
+ *        band follow each other and the input type is Byte, UInt16, Int16 or Float32, the tiles are
+ *        filtered from the input and into the output in place, without a copy. Other layouts are read and
+ *        written with GDALRasterIO.
+ *
+ * @param filter The filter.
+ * @param input The input image, only read.
+ * @param output The output image, overwritten.
+ *
+ * @return double The time taken to filter the image, or a negative value if the images do not match.
+*/
+LAB4_API double lab4_filter_buffer(const lab4_filter* filter, const lab4_buffer* input, const lab4_buffer* output);
+
+/**
+ * @brief Filter a dataset opened by the caller, such as a GeoTIFF in /vsimem/, into an image in memory,
+ *        written in place as by lab4_filter_buffer. Each thread reads with its own handle on the file of
+ *        the dataset, or shares the dataset behind a lock if it has no file.
+ *
+ * @param filter The filter.
+ * @param input_dataset The input dataset.
+ * @param output The output image, of the size and band count of the dataset.
+ *
+ * @return double The time taken to filter the dataset, or a negative value if the image does not match.
+*/
+LAB4_API double lab4_filter_dataset(const lab4_filter* filter, GDALDatasetH input_dataset, const lab4_buffer* output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LAB4_H__
@@ -1,9 +1,23 @@
 #ifndef __MAIN_H__
 #define __MAIN_H__
 
+#include <getopt.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+
+#include "batch.h"
+#include "bench.h"
+#include "chain.h"
 #include "common.h"
+#include "counters.h"
+#include "generate.h"
+#include "kernel.h"
 #include "processes.h"
+#include "server.h"
 #include "strips.h"
+#include "trace.h"
+#include "tune.h"
 
 /**
  * @brief applies the given kernel to the input dataset and saves it to the output dataset.
@@ -13,33 +27,119 @@
  * @param kern the kernel to be applied.
  * @param x_size the width of the dataset.
  * @param y_size the height of the dataset.
+ * @param slab_first the first row to filter, the whole dataset is filtered from 0.
+ * @param slab_last the row after the last one to filter, y_size for the whole dataset.
+ * @param options the processing options.
  * 
- * @return the time taken to process the dataset.
+ * @return the time taken to process the dataset, or -1 if a stage failed.
 */
-double process_dataset(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const int kern[3][3], int x_size, int y_size);
+double process_dataset(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int x_size, int y_size, int slab_first, int slab_last, const process_options* options);
 
 /**
- * @brief applies the given kernel to the input file and saves it to the output file.
+ * @brief applies the given kernel to the input dataset and saves it to the output dataset with the tile engine:
+ *        each chunk of rows is read with its halo by one call, filtered by tiles of columns sized to the
+ *        cache and written by one call. The filter chain of the options, if any, is applied instead of the kernel.
  * 
- * @param input_path the input file path.
- * @param output_path the output file path.
+ * @param input_dataset the input dataset.
+ * @param output_dataset the output dataset.
  * @param kern the kernel to be applied.
+ * @param x_size the width of the dataset.
+ * @param y_size the height of the dataset.
+ * @param slab_first the first row to filter, the whole dataset is filtered from 0.
+ * @param slab_last the row after the last one to filter, y_size for the whole dataset.
+ * @param options the processing options.
  * 
- * @return the time taken to process the file.
+ * @return the time taken to process the dataset.
 */
-double process_file(const char* input_path, const char* output_path, const int kern[3][3]);
+double process_dataset_tiles(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int x_size, int y_size, int slab_first, int slab_last, const process_options* options);
+
+#ifdef PARALLEL_PROCESSING
+    /**
+     * @brief Create the tasks of process_dataset and wait for them. Called by one thread of a parallel region, so several datasets can be filtered by the
+     *        same threads at the same time, the tasks of each one interleaved with the tasks of the others.
+     * 
+     * @param input_dataset the input dataset.
+     * @param output_dataset the output dataset.
+     * @param kern the kernel to be applied.
+     * @param x_size the width of the dataset.
+     * @param y_size the height of the dataset.
+     * @param slab_first the first row to filter, the whole dataset is filtered from 0.
+     * @param slab_last the row after the last one to filter, y_size for the whole dataset.
+     * @param options the processing options.
+     * 
+     * @return 0 on success, -1 if a stage failed.
+    */
+    int process_dataset_graph(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int x_size, int y_size, int slab_first, int slab_last, const process_options* options);
 
-#ifdef TEST
     /**
-     * @brief tests the performance of the filtering algorithm by applying the given kernel N (define by macro TEST) times on the given input file and saving it to the given output file.
+     * @brief Create the tasks of process_dataset_tiles and wait for them, as process_dataset_graph.
      * 
-     * @param input_path the input file path.
-     * @param output_path the output file path.
+     * @param input_dataset the input dataset.
+     * @param output_dataset the output dataset.
      * @param kern the kernel to be applied.
+     * @param x_size the width of the dataset.
+     * @param y_size the height of the dataset.
+     * @param slab_first the first row to filter, the whole dataset is filtered from 0.
+     * @param slab_last the row after the last one to filter, y_size for the whole dataset.
+     * @param options the processing options.
      * 
      * @return void.
     */
-    void testing(const char* input_path, const char* output_path, const int kern[3][3]);
+    void process_dataset_tiles_graph(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int x_size, int y_size, int slab_first, int slab_last, const process_options* options);
 #endif
 
+/**
+ * @brief Create the output dataset of an input dataset: same size and band count, data type of the options.
+ * 
+ * @param input_dataset The input dataset.
+ * @param output_path The output file path.
+ * @param options The processing options.
+ * 
+ * @return GDALDatasetH The output dataset, or NULL if it can not be created.
+*/
+GDALDatasetH create_output_dataset(GDALDatasetH input_dataset, const char* output_path, const process_options* options);
+
+/**
+ * @brief applies the given kernel to the input file and saves it to the output file. On MPI builds
+ *        each rank filters and writes its own slab of rows.
+ * 
+ * @param input_path the input file path.
+ * @param output_path the output file path.
+ * @param kern the kernel to be applied.
+ * @param options the processing options.
+ * 
+ * @return the time taken to process the file, by the slowest rank on MPI builds.
+*/
+double process_file(const char* input_path, const char* output_path, const kernel* kern, const process_options* options);
+
+/**
+ * @brief Parse an output data type name (Byte, UInt16, Int16 or Float32).
+ * 
+ * @param text The text to parse.
+ * @param type The parsed data type.
+ * 
+ * @return int 0 on success, -1 if the text is not a supported data type.
+*/
+int parse_output_type(const char* text, GDALDataType* type);
+
+/**
+ * @brief Parse a finite float.
+ * 
+ * @param text The text to parse.
+ * @param value The parsed value.
+ * 
+ * @return int 0 on success, -1 if the text is not a valid float.
+*/
+int parse_float(const char* text, float* value);
+
+/**
+ * @brief Find a text in a list of choices, ignoring case.
+ * 
+ * @param text The text to find.
+ * @param choices The choices, ended by NULL.
+ * 
+ * @return const char* The matching choice, or NULL if the text is not one of them.
+*/
+const char* parse_choice(const char* text, const char* const* choices);
+
 #endif // __MAIN_H__
\ No newline at end of file
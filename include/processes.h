@@ -2,36 +2,186 @@
 #define __PROCESSES_H__
 
 #include "common.h"
+#include "convolve.h"
+#include "datasets.h"
+#include "kernel.h"
+#include "stats.h"
 #include "strips.h"
 
+/* Define the engines that can filter a dataset */
+typedef enum process_engine
+{
+    ENGINE_STRIPS,  // Pipeline of full width strips, one task per chunk of rows
+    ENGINE_TILES    // Chunks of rows filtered by tiles of columns sized to the cache
+} process_engine;
+
+/* Define struct to store the processing options */
+typedef struct process_options
+{
+    size_t memory_budget;     // Maximum bytes of strips in flight (0 means unbounded)
+    GDALDataType output_type; // Data type of the output dataset and of the filtered strips
+    float scale;              // Scale applied to the kernel sums before quantization
+    float offset;             // Offset added to the scaled sums before quantization
+    int parallel_write;       // Write with one handle per thread on an output whose blocks are allocated
+    int interleaved_read;     // Read all the bands of a chunk with a single GDALDatasetRasterIO call
+    int mapped_read;          // Filter the input rows in place from a memory mapping of its bands when they allow it
+    char** create_options;    // GTiff creation options of the output dataset (layout, compression, BigTIFF)
+    process_engine engine;    // Engine that filters the dataset
+    int tile_width;           // Columns of the tiles of the tile engine (0 to size them to TILE_CACHE_BYTES)
+    const struct chain* chain; // Filter chain run by the tile engine instead of the kernel (NULL to apply the kernel)
+    void* const* input_bands;  // First row of each input band held in memory, rows of x_size pixels of the strip type,
+                               // filtered in place by the tile engine (NULL to read the input dataset)
+    void* const* output_bands; // First row of each output band held in memory, rows of x_size pixels of the output type,
+                               // filled in place by the tile engine (NULL to write the output dataset)
+    int quiet;                 // Do not print the progress of the tile engine, for programs embedding it (errors are still printed)
+    int output_first_row;      // Row of the image held by the first row of the output, when it only holds a slab (0 otherwise)
+} process_options;
+
+/**
+ * @brief applies the kernel to a given strip with float sums.
+ * 
+ * @param rows The kern->size input strips of floats centered on the strip to filter.
+ * @param output_strip The output strip of floats to save result.
+ * @param kern The kernel to apply.
+ * @param strip_width The width of the strip.
+ * @param scratch A strip of strip_width floats for the vertical pass of a separable kernel, kept by the caller across strips.
+ * 
+ * @return void.
+*/
+void apply_kern(const float* const* rows, float* output_strip, const kernel* kern, int strip_width, float* scratch);
+
+/**
+ * @brief Set the minimum number of rows moved on each GDALRasterIO call, rounded up to whole blocks by
+ *        get_chunk_rows. It applies to every dataset filtered afterwards.
+ * 
+ * @param rows The minimum rows of the chunks, IO_CHUNK_MIN_ROWS if not positive.
+ * 
+ * @return void.
+*/
+void set_chunk_min_rows(int rows);
+
+/**
+ * @brief Get the minimum number of rows moved on each GDALRasterIO call.
+ * 
+ * @return int The minimum rows of the chunks.
+*/
+int get_chunk_min_rows(void);
+
+/**
+ * @brief Set the rows filtered by each task of the strip engine, one by default. Larger grains create
+ *        fewer tasks, which pays when a row is filtered faster than a task is scheduled.
+ * 
+ * @param grainsize The rows of each filter task, 1 if not positive.
+ * 
+ * @return void.
+*/
+void set_filter_grainsize(int grainsize);
+
+/**
+ * @brief Get the rows filtered by each task of the strip engine.
+ * 
+ * @return int The rows of each filter task.
+*/
+int get_filter_grainsize(void);
+
+/**
+ * @brief Get the number of rows moved on each GDALRasterIO call for a band.
+ * 
+ * @param band The band to get the chunk height of.
+ * @param y_size The number of strips of the band.
+ * 
+ * @return int The chunk height, a multiple of the band native block height.
+*/
+int get_chunk_rows(GDALRasterBandH band, int y_size);
+
+/**
+ * @brief Get the data type the strips of a band are read and held with: its native type if it is Byte,
+ *        UInt16 or Int16, Float32 otherwise.
+ * 
+ * @param band The band to read.
+ * 
+ * @return GDALDataType The data type of the input strips.
+*/
+GDALDataType get_strip_type(GDALRasterBandH band);
+
+/**
+ * @brief Get the data type of the kernel sums: Int32 when the kernel has integer weights and the input
+ *        strips are integers, so the sums stay on integers, Float32 otherwise.
+ * 
+ * @param kern The kernel to apply.
+ * @param type The data type of the input strips.
+ * 
+ * @return GDALDataType The data type of the kernel sums.
+*/
+GDALDataType get_sum_type(const kernel* kern, GDALDataType type);
+
+/**
+ * @brief Get the data type the strip engine reads the strips of a band with for a kernel: the one of
+ *        get_strip_type, or Float32 when the kernel sums are floats, so each row is converted once.
+ * 
+ * @param kern The kernel to apply.
+ * @param band The band to read.
+ * 
+ * @return GDALDataType The data type of the input strips.
+*/
+GDALDataType get_kernel_strip_type(const kernel* kern, GDALRasterBandH band);
+
 #ifdef PARALLEL_PROCESSING
     /**
      * @brief Write a strip list on a band of TIFF file.
      * 
      * @param buffer The strip list to write.
-     * @param dataset The dataset to write to.
-     * @param dataset_mutex The mutex to lock the dataset with.
+     * @param pool The pool of handles on the dataset to write to.
      * @param x_size The width of the strips.
      * @param y_size The number of strips.
      * @param band_index The band index to write to.
+     * @param type The data type of the strips, the output type of the processing options.
+     * @param first_row The first strip to write.
+     * @param last_row The strip after the last one to write.
+     * @param output_first_row The strip written on the first row of the dataset, 0 unless it only holds a slab.
      * 
-     * @return void.
+     * @return int 0 on success, -1 if a strip is missing, its row is then written as zeros, or the band can not be written.
     */
-    void write_tiff(strip_list* buffer, GDALDatasetH dataset, omp_lock_t* dataset_mutex, int x_size, int y_size, int band_index);
+    int write_tiff(strip_list* buffer, dataset_pool* pool, int x_size, int y_size, int band_index, GDALDataType type, int first_row, int last_row, int output_first_row);
 
     /**
      * @brief Read a strip list from a band of TIFF file.
      * 
      * @param buffer The strip list to read to.
-     * @param dataset The dataset to read from.
-     * @param dataset_mutex The mutex to lock the dataset with.
+     * @param pool The pool of handles on the dataset to read from.
      * @param x_size The width of the strips.
      * @param y_size The number of strips.
      * @param band_index The band index to read from.
+     * @param type The data type to read the strips with, the output of get_kernel_strip_type.
+     * @param first_row The first strip to read.
+     * @param last_row The strip after the last one to read.
+     * @param radius The number of halo strips of the filter, used to count the uses of each strip.
+     * @param slab_first The first strip filtered, the strips above it are only read as its halo.
+     * @param slab_last The strip after the last one filtered, the strips from it are only read as its halo.
      * 
-     * @return void.
+     * @return int 0 on success, -1 if the band can not be read or a strip can not be added to its list.
+    */
+    int read_tiff(strip_list* buffer, dataset_pool* pool, int x_size, int y_size, int band_index, GDALDataType type, int first_row, int last_row, int radius, int slab_first, int slab_last);
+
+    /**
+     * @brief Read the rows of every band of a TIFF file with one GDALDatasetRasterIO call per chunk, so a
+     *        pixel interleaved file is decoded once for all its bands.
+     * 
+     * @param buffers The strip lists to save the strips of each band to.
+     * @param pool The pool of handles on the dataset to read from.
+     * @param x_size The width of the strips.
+     * @param y_size The number of strips.
+     * @param bands The number of bands to read, from band 1.
+     * @param type The data type to read the strips with, the output of get_kernel_strip_type.
+     * @param first_row The first strip to read.
+     * @param last_row The strip after the last one to read.
+     * @param radius The number of halo strips of the filter, used to count the uses of each strip.
+     * @param slab_first The first strip filtered, the strips above it are only read as its halo.
+     * @param slab_last The strip after the last one filtered, the strips from it are only read as its halo.
+     * 
+     * @return int 0 on success, -1 if the bands can not be read or a strip can not be added to its list.
     */
-    void read_tiff(strip_list* buffer, GDALDatasetH dataset, omp_lock_t* dataset_mutex, int x_size, int y_size, int band_index);
+    int read_tiff_bands(strip_list** buffers, dataset_pool* pool, int x_size, int y_size, int bands, GDALDataType type, int first_row, int last_row, int radius, int slab_first, int slab_last);
 #else
     /**
      * @brief Write a strip list on a band of TIFF file.
@@ -41,10 +191,14 @@
      * @param x_size The width of the strips.
      * @param y_size The number of strips.
      * @param band_index The band index to write to.
+     * @param type The data type of the strips, the output type of the processing options.
+     * @param first_row The first strip to write.
+     * @param last_row The strip after the last one to write.
+     * @param output_first_row The strip written on the first row of the dataset, 0 unless it only holds a slab.
      * 
-     * @return void.
+     * @return int 0 on success, -1 if a strip is missing, its row is then written as zeros, or the band can not be written.
     */
-    void write_tiff(strip_list* buffer, GDALDatasetH dataset, int x_size, int y_size, int band_index);
+    int write_tiff(strip_list* buffer, GDALDatasetH dataset, int x_size, int y_size, int band_index, GDALDataType type, int first_row, int last_row, int output_first_row);
 
     /**
      * @brief Read a strip list from a band of TIFF file.
@@ -54,24 +208,111 @@
      * @param x_size The width of the strips.
      * @param y_size The number of strips.
      * @param band_index The band index to read from.
+     * @param type The data type to read the strips with, the output of get_kernel_strip_type.
+     * @param first_row The first strip to read.
+     * @param last_row The strip after the last one to read.
+     * @param radius The number of halo strips of the filter, used to count the uses of each strip.
+     * @param slab_first The first strip filtered, the strips above it are only read as its halo.
+     * @param slab_last The strip after the last one filtered, the strips from it are only read as its halo.
      * 
-     * @return void.
+     * @return int 0 on success, -1 if the band can not be read or a strip can not be added to its list.
+    */
+    int read_tiff(strip_list* buffer, GDALDatasetH dataset, int x_size, int y_size, int band_index, GDALDataType type, int first_row, int last_row, int radius, int slab_first, int slab_last);
+
+    /**
+     * @brief Read the rows of every band of a TIFF file with one GDALDatasetRasterIO call per chunk, so a
+     *        pixel interleaved file is decoded once for all its bands.
+     * 
+     * @param buffers The strip lists to save the strips of each band to.
+     * @param dataset The dataset to read from.
+     * @param x_size The width of the strips.
+     * @param y_size The number of strips.
+     * @param bands The number of bands to read, from band 1.
+     * @param type The data type to read the strips with, the output of get_kernel_strip_type.
+     * @param first_row The first strip to read.
+     * @param last_row The strip after the last one to read.
+     * @param radius The number of halo strips of the filter, used to count the uses of each strip.
+     * @param slab_first The first strip filtered, the strips above it are only read as its halo.
+     * @param slab_last The strip after the last one filtered, the strips from it are only read as its halo.
+     * 
+     * @return int 0 on success, -1 if the bands can not be read or a strip can not be added to its list.
     */
-    void read_tiff(strip_list* buffer, GDALDatasetH dataset, int x_size, int y_size, int band_index);
+    int read_tiff_bands(strip_list** buffers, GDALDatasetH dataset, int x_size, int y_size, int bands, GDALDataType type, int first_row, int last_row, int radius, int slab_first, int slab_last);
 #endif
 
 /**
  * @brief Applies the given kernel to the input strip list and saves it to the output strip list.
+ *        The input strips from first_row - kern->radius to last_row - 1 + kern->radius must be in the list.
  * 
  * @param read_buffer The input strip list.
  * @param write_buffer The output strip list.
  * @param x_size The width of the strips.
  * @param y_size The number of strips.
  * @param band_index The band index to apply the kernel to.
+ * @param type The data type of the input strips, the output of get_kernel_strip_type.
  * @param kern The kernel to be applied.
+ * @param options The processing options, the output strips are quantized to their output type, scale and offset.
+ * @param first_row The first strip to filter.
+ * @param last_row The strip after the last one to filter.
+ * 
+ * @return int 0 on success, -1 if a strip to filter is missing or a filtered strip can not be added to the output list.
+*/
+int filter_tiff(strip_list* read_buffer, strip_list* write_buffer, int x_size, int y_size, int band_index, GDALDataType type, const kernel* kern, const process_options* options, int first_row, int last_row);
+
+/**
+ * @brief Applies the given kernel to a tile of a chunk of rows held in one buffer, quantizing it to the output
+ *        type of the options. The input rows from first_row - kern->radius to last_row - 1 + kern->radius
+ *        (clamped to the image) must be in the input buffer.
+ * 
+ * @param input_rows The input rows, x_size pixels each, from input_first_row.
+ * @param input_first_row The index of the first row of the input buffer.
+ * @param output_rows The output rows, x_size pixels each, from first_row.
+ * @param x_size The width of the rows.
+ * @param y_size The height of the image.
+ * @param type The data type of the input rows.
+ * @param kern The kernel to be applied.
+ * @param options The processing options.
+ * @param first_row The first row of the tile.
+ * @param last_row The row after the last one of the tile.
+ * @param first_column The first column of the tile.
+ * @param last_column The column after the last one of the tile.
  * 
  * @return void.
 */
-void filter_tiff(strip_list* read_buffer, strip_list* write_buffer, int x_size, int y_size, int band_index, const int kern[3][3]);
+void filter_tile(const void* input_rows, int input_first_row, void* output_rows, int x_size, int y_size, GDALDataType type, const kernel* kern, const process_options* options, int first_row, int last_row, int first_column, int last_column);
+
+#ifdef PARALLEL_PROCESSING
+    /**
+     * @brief Read or write a chunk of rows of a band of TIFF file with one GDALRasterIO call.
+     * 
+     * @param rows The buffer of the rows, x_size pixels each.
+     * @param pool The pool of handles on the dataset.
+     * @param x_size The width of the rows.
+     * @param band_index The band index to read from or write to.
+     * @param type The data type of the buffer.
+     * @param rw_flag GF_Read or GF_Write.
+     * @param first_row The first row to move.
+     * @param last_row The row after the last one to move.
+     * 
+     * @return void.
+    */
+    void transfer_rows(void* rows, dataset_pool* pool, int x_size, int band_index, GDALDataType type, GDALRWFlag rw_flag, int first_row, int last_row);
+#else
+    /**
+     * @brief Read or write a chunk of rows of a band of TIFF file with one GDALRasterIO call.
+     * 
+     * @param rows The buffer of the rows, x_size pixels each.
+     * @param dataset The dataset.
+     * @param x_size The width of the rows.
+     * @param band_index The band index to read from or write to.
+     * @param type The data type of the buffer.
+     * @param rw_flag GF_Read or GF_Write.
+     * @param first_row The first row to move.
+     * @param last_row The row after the last one to move.
+     * 
+     * @return void.
+    */
+    void transfer_rows(void* rows, GDALDatasetH dataset, int x_size, int band_index, GDALDataType type, GDALRWFlag rw_flag, int first_row, int last_row);
+#endif
 
 #endif // __PROCESSES_H__
\ No newline at end of file
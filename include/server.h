@@ -0,0 +1,76 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "chain.h"
+#include "common.h"
+#include "kernel.h"
+#include "processes.h"
+#include "stats.h"
+
+/* Jobs waiting to run before new ones are turned away with BUSY */
+#define SERVER_QUEUE_DEPTH 16
+
+/* Longest request line, with its paths and options */
+#define SERVER_LINE_MAX 4096
+
+/* Seconds a client has to send its request, so a stalled client does not hold its thread forever */
+#define SERVER_READ_TIMEOUT 5
+
+/* Requests read at the same time, each one on its own thread, before new connections are turned away with BUSY */
+#define SERVER_CONNECTIONS_MAX 64
+
+/* Define struct to store a job admitted by the server */
+typedef struct server_job
+{
+    int fd;                     // Connection of the client, answered when the job ends
+    char** tokens;              // Tokens of the request, the paths and option values point into them
+    const char* input_path;     // Input file path
+    const char* output_path;    // Output file path
+    const char* kernel_name;    // Kernel of the job, NULL for the kernel of the server
+    const char* chain_steps;    // Chain of the job, NULL for the chain of the server
+    process_options options;    // Options of the server with the ones of the job applied
+    double submitted;           // Time the job was admitted
+} server_job;
+
+/**
+ * @brief Serve filtering jobs on a Unix domain socket until a SHUTDOWN request. Each connection sends one
+ *        request line and gets one reply line:
+ *
+ *          JOB <input_path> <output_path> [--kernel <name|path>] [--chain <steps|path>] [--engine <name>]
+ *              [--output-type <type>] [--scale <value>] [--offset <value>]
+ *                  -> OK wait=<s> time=<s> total=<s> read=<s> filter=<s> write=<s> mpixels=<n>, BUSY or ERROR
+ *          STATUS  -> OK queued=<n> running=<n> done=<n> failed=<n> rejected=<n>
+ *          SHUTDOWN -> OK, once the jobs already admitted have run
+ *
+ *        A thread accepts the connections, whose requests are read and answered or admitted by a thread
+ *        each, while the calling thread runs the jobs one at a time, each one on every thread of the OpenMP
+ *        pool, which stays up between jobs.
+ *
+ * @param socket_path The path of the socket. A stale socket left by a server that is gone is replaced.
+ * @param kern The kernel of the jobs that do not give one.
+ * @param options The options of the jobs, the jobs can change the filter and the output data type.
+ * @param queue_depth The jobs waiting to run before new ones are rejected.
+ *
+ * @return int 0 on success, -1 if the socket can not be set up.
+*/
+int serve(const char* socket_path, const kernel* kern, const process_options* options, int queue_depth);
+
+/**
+ * @brief Send a request to a server and print its reply.
+ *
+ * @param argc The number of arguments: the socket path, then the tokens of the request.
+ * @param argv The arguments, quoted when sent if they hold spaces or quotes.
+ *
+ * @return int 0 if the server replies OK, -1 otherwise.
+*/
+int submit(int argc, char* argv[]);
+
+#endif // __SERVER_H__
@@ -0,0 +1,137 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "common.h"
+
+/* Highest band with its own counters, the bands above it share its counters. Band 0 counts the work done
+   for every band at once, as the interleaved reads. */
+#define STATS_MAX_BANDS 64
+
+/* Define the stages of the pipeline */
+typedef enum process_stage
+{
+    STAGE_READ,     // Reading the input rows
+    STAGE_FILTER,   // Filtering and quantizing the rows
+    STAGE_WRITE,    // Writing the output rows
+    STAGE_COUNT     // Number of stages
+} process_stage;
+
+/**
+ * @brief Get the current time, in seconds, from the clock the filtering algorithm is timed with.
+ *
+ * @return double The current time.
+*/
+double stats_now(void);
+
+/**
+ * @brief Get the start time of a timed work, and take a snapshot of the hardware counters of the calling
+ *        thread when they are enabled, so stats_add also adds the events of the work to its stage.
+ *
+ * @return double The current time, from stats_now.
+*/
+double stats_start(void);
+
+/**
+ * @brief Add the time elapsed since a start time to the busy time of a stage on a band, and widen the span
+ *        of the stage on the band to it. Every thread adds the time of its own work, so the busy time of a
+ *        stage is the sum of the time of its work on all threads.
+ *
+ * @param stage The stage to add to.
+ * @param band_index The band of the work, from 1, or 0 for work done for every band at once.
+ * @param start_time The start of the work, from stats_now.
+ *
+ * @return void.
+*/
+void stats_add(process_stage stage, int band_index, double start_time);
+
+/**
+ * @brief Add the time elapsed since a start time to the time spent waiting for the lock of a shared dataset.
+ *
+ * @param start_time The start of the wait, from stats_now.
+ *
+ * @return void.
+*/
+void stats_add_lock_wait(double start_time);
+
+/**
+ * @brief Record the strip lists of a band once it is processed: their peak occupancy and their accesses.
+ *
+ * @param band_index The band of the strip lists, from 1.
+ * @param read_peak The peak number of strips held by the read list.
+ * @param write_peak The peak number of strips held by the write list.
+ * @param accesses The number of get accesses to the read list.
+ * @param misses The number of get accesses to strips not in the read list.
+ *
+ * @return void.
+*/
+void stats_add_lists(int band_index, int read_peak, int write_peak, unsigned long accesses, unsigned long misses);
+
+/**
+ * @brief Add filtered rows to the throughput, once per band.
+ *
+ * @param rows The number of rows.
+ * @param x_size The width of the rows.
+ *
+ * @return void.
+*/
+void stats_add_rows(long rows, int x_size);
+
+/**
+ * @brief Get the pixels filtered since the last reset, on this rank.
+ *
+ * @return unsigned long long The number of pixels.
+*/
+unsigned long long stats_get_pixels(void);
+
+/**
+ * @brief Reset every counter and start the clock of the spans.
+ *
+ * @return void.
+*/
+void stats_reset(void);
+
+/**
+ * @brief Get the busy time of a stage on every band since the last reset.
+ *
+ * @param stage The stage.
+ *
+ * @return double The busy time, in seconds.
+*/
+double stats_get_busy(process_stage stage);
+
+/**
+ * @brief Get the name of a stage.
+ *
+ * @param stage The stage.
+ *
+ * @return const char* The name of the stage (read, filter or write).
+*/
+const char* stats_get_stage_name(process_stage stage);
+
+/**
+ * @brief Print the counters since the last reset: for each band and stage the busy time, the span from the
+ *        start of its first work to the end of its last one and the idle time of the span, then the peak
+ *        occupancy and hit ratio of the strip lists, the lock waits and the throughput. On MPI builds the
+ *        counters of every rank are gathered and printed by rank 0.
+ *
+ * @param file The file to print to.
+ * @param time The time taken to process the file.
+ *
+ * @return void.
+*/
+void stats_print(FILE* file, double time);
+
+/**
+ * @brief Write the counters printed by stats_print as JSON. On MPI builds only rank 0 writes.
+ *
+ * @param path The path of the JSON file.
+ * @param time The time taken to process the file.
+ *
+ * @return int 0 on success, -1 if the file can not be written.
+*/
+int stats_write_json(const char* path, double time);
+
+#endif // __STATS_H__
@@ -1,45 +1,64 @@
 #ifndef __STRIP_H__
 #define __STRIP_H__
 
+#include <stdatomic.h>
+
 #include "common.h"
 
-/* One strip is a 1D array of floats. */
-typedef float* strip;
+/* One strip is a 1D array of pixels. Its data type is not stored: every strip of a list has the data type
+   chosen by the stage that fills it. */
+typedef void* strip;
 
-/* Define struct to generate strips lists */
+/* Define struct to generate strips lists. Strips are stored on a fixed ring of slots indexed by the
+   strip index modulo the ring capacity. A strip is published by storing its pointer with release
+   semantics and looked up with acquire semantics, so add, get and release never take a lock.
+   A mapped list has no slots: it borrows every strip from a memory mapping of a whole band. */
 typedef struct strip_list
 {   
-    int size;                   // Number of strips in the list
-    int max_size;               // maximum size reached by the list
-    struct access_cache* cache; // Cache to store the last accessed strips
-    struct node* first_node;    // First node of the list
-    struct node* last_node;     // Last node of the list
-
-    #ifdef PARALLEL_PROCESSING
-        omp_lock_t mutex;  // Mutex to lock the list
-        int readers;       // Number of active readers 
-        int writer_active; // Is a writer active ?
-    #endif
+    atomic_int size;                   // Number of strips in the list
+    atomic_int max_size;               // maximum size reached by the list
+    int capacity;                      // Number of slots in the ring (always a power of two)
+    struct slot* slots;                // Ring of slots
+    atomic_ulong total_access;         // Total number of get access
+    atomic_ulong misses;               // Number of get access to a strip not in the list
+    char* mapping;                     // First strip of a mapped list, NULL otherwise
+    size_t line_space;                 // Bytes between two strips of a mapped list
+    int mapped_strips;                 // Number of strips of a mapped list
 } strip_list;
 
 /**
  * @brief Allocate memory to strip.
  * 
- * @param size The size of the strip.
+ * @param size The number of pixels of the strip.
+ * @param type The data type of the pixels.
  * 
  * @return strip The allocated memory.
 */
-strip strip_alloc(int size);
+strip strip_alloc(int size, GDALDataType type);
 
 /**
  * @brief Allocate memory to strip list.
  * 
+ * @param max_strips The maximum distance between the lowest and the highest index of the strips held at the same time.
+ * 
  * @return strip_list The allocated memory.
 */
-strip_list* strip_alloc_list(void);
+strip_list* strip_alloc_list(int max_strips);
 
 /**
- * @brief Free memory of strip list.
+ * @brief Allocate a strip list that borrows its strips from a memory mapping instead of holding them. Its
+ *        strips are never added, released nor freed, strip_list_get returns them in place.
+ * 
+ * @param mapping The first strip of the mapping.
+ * @param line_space The number of bytes between the start of two strips.
+ * @param strips The number of strips of the mapping.
+ * 
+ * @return strip_list The allocated memory.
+*/
+strip_list* strip_map_list(void* mapping, size_t line_space, int strips);
+
+/**
+ * @brief Free memory of strip list and the strips still in it.
  * 
  * @param list The strip list to free.
  * 
@@ -48,18 +67,40 @@ strip_list* strip_alloc_list(void);
 void strip_free_list(strip_list* list);
 
 /**
- * @brief Add a strip to the end of a strip list.
+ * @brief Add a strip with a single use to a strip list.
  * 
  * @param list The strip list to add to.
  * @param index The index of the strip to add.
  * @param content The strip to add.
  * 
+ * @return int 0 on success, -1 if the list is mapped or the slot of the strip is taken, the strip is then not added.
+*/
+int strip_list_add(strip_list* list, int index, strip content);
+
+/**
+ * @brief Add a strip to a strip list. The strip is freed once it has been released the given number of times.
+ * 
+ * @param list The strip list to add to.
+ * @param index The index of the strip to add.
+ * @param content The strip to add.
+ * @param uses The number of uses of the strip.
+ * 
+ * @return int 0 on success, -1 if the list is mapped or the slot of the strip is taken, the strip is then not added.
+*/
+int strip_list_add_shared(strip_list* list, int index, strip content, int uses);
+
+/**
+ * @brief Release one use of a strip, removing it from the strip list when it was the last one.
+ * 
+ * @param list The strip list to release from.
+ * @param index The index of the strip to release.
+ * 
  * @return void.
 */
-void strip_list_add(strip_list* list, int index, strip content);
+void strip_list_release(strip_list* list, int index);
 
 /**
- * @brief Remove a strip from a strip list by index.
+ * @brief Remove a strip from a strip list by index, regardless of its remaining uses.
  * 
  * @param list The strip list to remove from.
  * @param index The index of the strip to remove.
@@ -97,13 +138,13 @@ int strip_list_get_size(strip_list* list);
 int strip_list_get_max_size(strip_list* list);
 
 /**
- * @brief Get the number of access to strip in a strip list.
+ * @brief Get the number of uses not yet released of a strip in a strip list.
  * 
- * @param list The strip list to get the access of.
- * @param index The index of the strip to get the access of.
+ * @param list The strip list to get the uses of.
+ * @param index The index of the strip to get the uses of.
  * 
- * @return int The number of access to strip in a strip list.
+ * @return int The number of uses left, or -1 if the strip is not in the list.
 */
-int strip_list_get_access(strip_list* list, int index);
+int strip_list_get_uses(strip_list* list, int index);
 
-#endif // __STRIP_H__
\ No newline at end of file
+#endif // __STRIP_H__
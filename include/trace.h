@@ -0,0 +1,48 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdlib.h>
+
+#include "common.h"
+#include "stats.h"
+
+/* Kind of the events of the waits for the lock of a shared dataset, after the stages of the pipeline */
+#define TRACE_LOCK STAGE_COUNT
+
+/* Events each thread buffer holds at first, the buffers double when they are full */
+#define TRACE_INITIAL_EVENTS 4096
+
+/**
+ * @brief Start recording a timeline of the work of every thread: each read, filter and write timed by the
+ *        statistics becomes an event with its thread and band, and so does each wait for the lock of a
+ *        shared dataset. Each thread appends to its own buffer, so the threads never wait for each other.
+ *        On MPI builds the ranks start together, so their timelines share the same origin.
+ *
+ * @return void.
+*/
+void trace_start(void);
+
+/**
+ * @brief Record an event of the calling thread, if the timeline is being recorded.
+ *
+ * @param kind The kind of the event, a stage of the pipeline or TRACE_LOCK.
+ * @param band_index The band of the event, from 1, or 0 for work done for every band at once.
+ * @param start_time The start of the event, from stats_now.
+ * @param end_time The end of the event, from stats_now.
+ *
+ * @return void.
+*/
+void trace_add(int kind, int band_index, double start_time, double end_time);
+
+/**
+ * @brief Stop recording and write the timeline as Chrome trace event JSON, which chrome://tracing and the
+ *        Perfetto UI open: a row per thread, and a process per MPI rank gathered by rank 0. The buffers are
+ *        freed.
+ *
+ * @param path The path of the JSON file.
+ *
+ * @return int 0 on success, -1 if the file can not be written.
+*/
+int trace_write(const char* path);
+
+#endif // __TRACE_H__
@@ -0,0 +1,53 @@
+#ifndef __TUNE_H__
+#define __TUNE_H__
+
+#include <ctype.h>
+#include <string.h>
+
+#include "common.h"
+#include "kernel.h"
+#include "processes.h"
+
+/* Rows of the sample of the image the calibration passes filter */
+#define TUNE_SAMPLE_ROWS 2048
+
+/* Profile file of the tuned settings, in the working directory by default */
+#define TUNE_PROFILE_PATH ".lab4_tune"
+
+/* Dataset the calibration passes write to, in memory */
+#define TUNE_OUTPUT_PATH "/vsimem/lab4_tune.tif"
+
+/* Define struct to store the settings chosen by the autotuner */
+typedef struct tune_settings
+{
+    int chunk_rows;     // Minimum rows of the chunks, rounded up to whole blocks
+    int grainsize;      // Rows of each filter task of the strip engine
+    int threads;        // Number of threads of the parallel regions
+} tune_settings;
+
+/**
+ * @brief Apply tuned settings to the filtering of every dataset processed afterwards.
+ *
+ * @param settings The settings to apply.
+ *
+ * @return void.
+*/
+void tune_apply(const tune_settings* settings);
+
+/**
+ * @brief Tune the chunk height, the filter grain and the thread count for this machine and this image.
+ *        The settings of a profile line whose key matches the machine, the image shape and the filter are
+ *        reused. Otherwise short calibration passes filter a sample of the image for each candidate, one
+ *        setting at a time, and the fastest settings are added to the profile. The settings are then
+ *        applied. On MPI builds rank 0 tunes and the other ranks apply its settings.
+ *
+ * @param input_path The input file path.
+ * @param kern The kernel to be applied.
+ * @param options The processing options.
+ * @param profile_path The path of the profile file, created if it does not exist.
+ *
+ * @return int 0 on success, -1 if the input can not be opened.
+*/
+int tune(const char* input_path, const kernel* kern, const process_options* options, const char* profile_path);
+
+#endif // __TUNE_H__
@@ -0,0 +1,261 @@
+#include "batch.h"
+#include "main.h"
+
+batch* batch_load_manifest(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    const char* line;
+    int number = 0;
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed on open manifest %s !\n", path);
+        return NULL;
+    }
+
+    batch* jobs = (batch*) calloc(1, sizeof(batch));
+
+    while ((line = CPLReadLine(file)) != NULL)
+    {
+        number++;
+
+        while (*line == ' ' || *line == '\t')
+            line++;
+
+        if (*line == '#' || *line == '\0')
+            continue;
+
+        char** tokens = CSLTokenizeString2(line, " \t", CSLT_HONOURSTRINGS);
+
+        if (CSLCount(tokens) != 2)
+        {
+            fprintf(stderr, "Invalid manifest line %d, expected <input_path> <output_path>: %s !\n", number, line);
+
+            CSLDestroy(tokens);
+            CPLReadLine(NULL);
+            fclose(file);
+            batch_free(jobs);
+
+            return NULL;
+        }
+
+        jobs->inputs = CSLAddString(jobs->inputs, tokens[0]);
+        jobs->outputs = CSLAddString(jobs->outputs, tokens[1]);
+        jobs->count++;
+
+        CSLDestroy(tokens);
+    }
+
+    CPLReadLine(NULL);
+    fclose(file);
+
+    if (jobs->count == 0)
+    {
+        fprintf(stderr, "Empty manifest %s !\n", path);
+        batch_free(jobs);
+        return NULL;
+    }
+
+    return jobs;
+}
+
+batch* batch_load_glob(const char* pattern, const char* output_dir)
+{
+    glob_t matches;
+
+    if (glob(pattern, 0, NULL, &matches) != 0 || matches.gl_pathc == 0)
+    {
+        fprintf(stderr, "No file matches %s !\n", pattern);
+        globfree(&matches);
+        return NULL;
+    }
+
+    batch* jobs = (batch*) calloc(1, sizeof(batch));
+
+    for (size_t i = 0; i < matches.gl_pathc; i++)
+    {
+        const char* output_path = CPLFormFilename(output_dir, CPLGetFilename(matches.gl_pathv[i]), NULL);
+
+        /* An output in the directory of the inputs would replace its own input */
+        if (strcmp(output_path, matches.gl_pathv[i]) == 0)
+        {
+            fprintf(stderr, "Output %s would overwrite its input !\n", output_path);
+            globfree(&matches);
+            batch_free(jobs);
+            return NULL;
+        }
+
+        jobs->inputs = CSLAddString(jobs->inputs, matches.gl_pathv[i]);
+        jobs->outputs = CSLAddString(jobs->outputs, output_path);
+        jobs->count++;
+    }
+
+    globfree(&matches);
+
+    return jobs;
+}
+
+void batch_free(batch* jobs)
+{
+    if (jobs == NULL)
+        return;
+
+    CSLDestroy(jobs->inputs);
+    CSLDestroy(jobs->outputs);
+    free(jobs);
+}
+
+/**
+ * @brief Filter one file of a batch. On parallel builds it runs in a task of the batch region and creates
+ *        the tasks of the file in the same region.
+ *
+ * @param input_path The input file path.
+ * @param output_path The output file path.
+ * @param kern The kernel to be applied.
+ * @param options The processing options.
+ * @param pixels The number of pixels of the file.
+ *
+ * @return int 0 on success, -1 if the file can not be opened, its output created or its bands filtered.
+*/
+int batch_process_file(const char* input_path, const char* output_path, const kernel* kern, const process_options* options, unsigned long long* pixels)
+{
+    double start_time = stats_now();
+    int status = 0;
+    GDALDatasetH input_dataset = GDALOpen(input_path, GA_ReadOnly);
+
+    if (input_dataset == NULL)
+    {
+        fprintf(stderr, "Failed on open file %s !\n", input_path);
+        return -1;
+    }
+
+    int x_size = GDALGetRasterXSize(input_dataset);
+    int y_size = GDALGetRasterYSize(input_dataset);
+
+    GDALDatasetH output_dataset = create_output_dataset(input_dataset, output_path, options);
+
+    if (output_dataset == NULL)
+    {
+        fprintf(stderr, "Failed on create output dataset %s !\n", output_path);
+        GDALClose(input_dataset);
+        return -1;
+    }
+
+    #ifdef PARALLEL_PROCESSING
+        /* As in process_file, the handles of a parallel write rewrite the blocks written by the close */
+        if (options->parallel_write && dataset_supports_parallel_write(output_dataset))
+        {
+            GDALClose(output_dataset);
+
+            if ((output_dataset = GDALOpen(output_path, GA_Update)) == NULL)
+            {
+                fprintf(stderr, "Failed on open output dataset %s !\n", output_path);
+                GDALClose(input_dataset);
+                return -1;
+            }
+        }
+
+        if (options->engine == ENGINE_TILES)
+            process_dataset_tiles_graph(input_dataset, output_dataset, kern, x_size, y_size, 0, y_size, options);
+        else
+            status = process_dataset_graph(input_dataset, output_dataset, kern, x_size, y_size, 0, y_size, options);
+    #else
+        if (options->engine == ENGINE_TILES)
+            process_dataset_tiles(input_dataset, output_dataset, kern, x_size, y_size, 0, y_size, options);
+        else if (process_dataset(input_dataset, output_dataset, kern, x_size, y_size, 0, y_size, options) < 0)
+            status = -1;
+    #endif
+
+    *pixels = (unsigned long long)x_size * (unsigned long long)y_size * (unsigned long long)GDALGetRasterCount(input_dataset);
+
+    GDALClose(input_dataset);
+    GDALClose(output_dataset);
+
+    if (status != 0)
+    {
+        fprintf(stderr, "Failed on filter %s into %s !\n", input_path, output_path);
+        return -1;
+    }
+
+    fprintf(stdout, "\nFile %s done (%f seconds) !\n", output_path, stats_now() - start_time);
+
+    return 0;
+}
+
+double batch_process(const batch* jobs, const kernel* kern, const process_options* options, int* failures)
+{
+    unsigned long long pixels = 0;
+    int failed = 0;
+    int files = 0;
+    int rank = 0;
+    int ranks = 1;
+
+    #ifdef MPI_PROCESSING
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+    #endif
+
+    double start_time = stats_now();
+
+    #ifdef PARALLEL_PROCESSING
+        /* Dependency tokens of the file tasks: a file waits for the file BATCH_FILES_IN_FLIGHT before it */
+        char* in_flight = calloc(BATCH_FILES_IN_FLIGHT, sizeof(char));
+
+        /* Each file in flight sizes its window on its share of the memory budget, so the files together
+           stay within it */
+        process_options file_options = *options;
+
+        file_options.memory_budget = options->memory_budget / BATCH_FILES_IN_FLIGHT;
+
+        /* The file tasks are untied, so a thread waiting for the tasks of a file can run the tasks of the
+           other file in flight too */
+        #pragma omp parallel
+        {
+            #pragma omp single
+            for (int i = rank; i < jobs->count; i += ranks)
+            {
+                #pragma omp task untied depend(inout: in_flight[(i / ranks) % BATCH_FILES_IN_FLIGHT]) shared(pixels, failed, files, file_options)
+                {
+                    unsigned long long file_pixels = 0;
+                    int status = batch_process_file(jobs->inputs[i], jobs->outputs[i], kern, &file_options, &file_pixels);
+
+                    #pragma omp atomic
+                    pixels += file_pixels;
+
+                    #pragma omp atomic
+                    failed += (status != 0);
+
+                    #pragma omp atomic
+                    files++;
+                }
+            }
+        }
+
+        free(in_flight);
+    #else
+        for (int i = rank; i < jobs->count; i += ranks)
+        {
+            unsigned long long file_pixels = 0;
+
+            failed += (batch_process_file(jobs->inputs[i], jobs->outputs[i], kern, options, &file_pixels) != 0);
+            pixels += file_pixels;
+            files++;
+        }
+    #endif
+
+    double time = stats_now() - start_time;
+
+    #ifdef MPI_PROCESSING
+        MPI_Allreduce(MPI_IN_PLACE, &pixels, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &files, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    #endif
+
+    if (rank == 0 && time > 0)
+        fprintf(stdout, "\nBatch of %d files, %d failed (%.2f files/s, %.2f Mpixels/s) !\n", files, failed, (files - failed) / time, (double) pixels / time / 1e6);
+
+    *failures = failed;
+
+    return time;
+}
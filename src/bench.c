@@ -0,0 +1,291 @@
+#include "bench.h"
+#include "main.h"
+
+/* Define struct to store the summary of a series of times */
+typedef struct bench_summary
+{
+    double median;  // Median time
+    double p95;     // 95th percentile time, by nearest rank
+    double mean;    // Mean time
+    double stddev;  // Sample standard deviation of the times
+    double min;     // Minimum time
+    double max;     // Maximum time
+} bench_summary;
+
+/**
+ * @brief Compare two times for qsort.
+ *
+ * @param a The first time.
+ * @param b The second time.
+ *
+ * @return int The order of the times.
+*/
+int bench_compare(const void* a, const void* b)
+{
+    double first = *(const double*) a;
+    double second = *(const double*) b;
+
+    return (first > second) - (first < second);
+}
+
+/**
+ * @brief Summarize a series of times.
+ *
+ * @param times The times, left unchanged.
+ * @param count The number of times.
+ *
+ * @return bench_summary The summary of the times.
+*/
+bench_summary bench_summarize(const double* times, int count)
+{
+    bench_summary summary = { 0 };
+    double sorted[count];
+    double sum = 0;
+    double squares = 0;
+
+    memcpy(sorted, times, sizeof(double) * (size_t)count);
+    qsort(sorted, (size_t)count, sizeof(double), bench_compare);
+
+    for (int i = 0; i < count; i++)
+        sum += sorted[i];
+
+    summary.mean = sum / count;
+
+    for (int i = 0; i < count; i++)
+        squares += (sorted[i] - summary.mean) * (sorted[i] - summary.mean);
+
+    summary.median = (count % 2) ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+    summary.p95 = sorted[(int)ceil(0.95 * count) - 1];
+    summary.stddev = (count > 1) ? sqrt(squares / (count - 1)) : 0;
+    summary.min = sorted[0];
+    summary.max = sorted[count - 1];
+
+    return summary;
+}
+
+/**
+ * @brief Write a summary as a JSON object.
+ *
+ * @param file The file to write to.
+ * @param summary The summary to write.
+ *
+ * @return void.
+*/
+void bench_write_summary(FILE* file, const bench_summary* summary)
+{
+    fprintf(file, "{ \"median\": %.6f, \"p95\": %.6f, \"mean\": %.6f, \"stddev\": %.6f, \"min\": %.6f, \"max\": %.6f }", summary->median, summary->p95, summary->mean, summary->stddev, summary->min, summary->max);
+}
+
+/**
+ * @brief Write a string as a JSON string, escaping its quotes, backslashes and control characters.
+ *
+ * @param file The file to write to.
+ * @param text The string to write.
+ *
+ * @return void.
+*/
+void bench_write_string(FILE* file, const char* text)
+{
+    fputc('"', file);
+
+    for (const char* c = text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20)
+            fprintf(file, "\\u%04x", (unsigned)*c);
+        else
+            fputc(*c, file);
+    }
+
+    fputc('"', file);
+}
+
+/**
+ * @brief Run the file once and get its time and the busy time of each stage, summed over the MPI ranks.
+ *
+ * @param input_path The input file path.
+ * @param output_path The output file path.
+ * @param kern The kernel to be applied.
+ * @param options The processing options.
+ * @param stages The busy time of each stage.
+ *
+ * @return double The time of the run.
+*/
+double bench_run(const char* input_path, const char* output_path, const kernel* kern, const process_options* options, double* stages)
+{
+    stats_reset();
+
+    double time = process_file(input_path, output_path, kern, options);
+
+    for (int s = 0; s < STAGE_COUNT; s++)
+        stages[s] = stats_get_busy((process_stage)s);
+
+    #ifdef MPI_PROCESSING
+        MPI_Allreduce(MPI_IN_PLACE, stages, STAGE_COUNT, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    #endif
+
+    return time;
+}
+
+int bench(const char* input_path, const char* output_path, const kernel* kern, const process_options* options, const bench_options* bench)
+{
+    int rank = 0;
+    int default_threads = 1;
+    const char* build_mode = "sequential";
+    const char* build_mpi = "false";
+
+    #ifdef MPI_PROCESSING
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        build_mpi = "true";
+    #endif
+
+    #ifdef PARALLEL_PROCESSING
+        default_threads = omp_get_max_threads();
+        build_mode = "parallel";
+    #else
+        if (bench->threads)
+            fprintf(stderr, "Thread counts are ignored on the sequential build !\n");
+    #endif
+
+    int sweeps = (bench->threads && bench->threads_count > 0) ? bench->threads_count : 1;
+
+    #ifndef PARALLEL_PROCESSING
+        sweeps = 1;
+    #endif
+
+    GDALDatasetH input_dataset = GDALOpen(input_path, GA_ReadOnly);
+
+    if (input_dataset == NULL)
+    {
+        fprintf(stderr, "Failed on open file %s !\n", input_path);
+        return -1;
+    }
+
+    int x_size = GDALGetRasterXSize(input_dataset);
+    int y_size = GDALGetRasterYSize(input_dataset);
+    int bands = GDALGetRasterCount(input_dataset);
+
+    GDALClose(input_dataset);
+
+    FILE* json = NULL;
+
+    if (rank == 0 && bench->json_path && (json = fopen(bench->json_path, "w")) == NULL)
+    {
+        fprintf(stderr, "Failed on open results file %s !\n", bench->json_path);
+
+        #ifdef MPI_PROCESSING
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        #endif
+
+        return -1;
+    }
+
+    if (json)
+    {
+        fprintf(json, "{\n");
+        fprintf(json, "  \"build\": { \"mode\": \"%s\", \"mpi\": %s, \"compiler\": \"%s\", \"date\": \"%s %s\" },\n", build_mode, build_mpi, __VERSION__, __DATE__, __TIME__);
+        fprintf(json, "  \"input\": { \"path\": ");
+        bench_write_string(json, input_path);
+        fprintf(json, ", \"x_size\": %d, \"y_size\": %d, \"bands\": %d },\n", x_size, y_size, bands);
+        fprintf(json, "  \"filter\": ");
+        bench_write_string(json, bench->filter);
+        fprintf(json, ", \"isa\": \"%s\", \"engine\": \"%s\", \"output_type\": \"%s\",\n", convolve_get_isa(), (options->engine == ENGINE_TILES) ? "tiles" : "strips", GDALGetDataTypeName(options->output_type));
+        fprintf(json, "  \"iterations\": %d, \"warmup\": %d,\n", bench->iterations, bench->warmup);
+        fprintf(json, "  \"runs\": [\n");
+    }
+
+    double times[bench->iterations];
+    double stages[STAGE_COUNT][bench->iterations];
+    double stage_times[STAGE_COUNT];
+    double first_median = 0;
+
+    for (int sweep = 0; sweep < sweeps; sweep++)
+    {
+        int threads = default_threads;
+
+        #ifdef PARALLEL_PROCESSING
+            if (bench->threads)
+                threads = bench->threads[sweep];
+
+            omp_set_num_threads(threads);
+        #endif
+
+        for (int i = 0; i < bench->warmup; i++)
+        {
+            fprintf(stdout, "\nStarting warmup %d / %d with %d threads !\n", i + 1, bench->warmup, threads);
+
+            bench_run(input_path, output_path, kern, options, stage_times);
+        }
+
+        for (int i = 0; i < bench->iterations; i++)
+        {
+            fprintf(stdout, "\nStarting process %d / %d with %d threads !\n", i + 1, bench->iterations, threads);
+
+            times[i] = bench_run(input_path, output_path, kern, options, stage_times);
+
+            for (int s = 0; s < STAGE_COUNT; s++)
+                stages[s][i] = stage_times[s];
+        }
+
+        bench_summary summary = bench_summarize(times, bench->iterations);
+
+        if (sweep == 0)
+            first_median = summary.median;
+
+        double speedup = (summary.median > 0) ? first_median / summary.median : 0;
+        double megapixels = (summary.median > 0) ? (double)x_size * (double)y_size * (double)bands / summary.median / 1e6 : 0;
+
+        if (rank == 0)
+        {
+            fprintf(stdout, "\n\nThreads: %d\n", threads);
+            fprintf(stdout, "Time median: %f  p95: %f  mean: %f  stddev: %f  min: %f  max: %f\n", summary.median, summary.p95, summary.mean, summary.stddev, summary.min, summary.max);
+
+            for (int s = 0; s < STAGE_COUNT; s++)
+            {
+                bench_summary stage = bench_summarize(stages[s], bench->iterations);
+
+                fprintf(stdout, "Stage %-6s busy median: %f  p95: %f\n", stats_get_stage_name((process_stage)s), stage.median, stage.p95);
+            }
+
+            fprintf(stdout, "Throughput: %.2f Mpixels/s  Speedup: %.2f\n", megapixels, speedup);
+        }
+
+        if (json)
+        {
+            fprintf(json, "    {\n      \"threads\": %d,\n      \"time\": ", threads);
+            bench_write_summary(json, &summary);
+            fprintf(json, ",\n      \"times\": [");
+
+            for (int i = 0; i < bench->iterations; i++)
+                fprintf(json, "%s%.6f", i ? ", " : "", times[i]);
+
+            fprintf(json, "],\n      \"stages\": {\n");
+
+            for (int s = 0; s < STAGE_COUNT; s++)
+            {
+                bench_summary stage = bench_summarize(stages[s], bench->iterations);
+
+                fprintf(json, "        \"%s\": ", stats_get_stage_name((process_stage)s));
+                bench_write_summary(json, &stage);
+                fprintf(json, "%s\n", (s + 1 < STAGE_COUNT) ? "," : "");
+            }
+
+            fprintf(json, "      },\n      \"mpixels_per_second\": %.3f,\n      \"speedup\": %.3f\n    }%s\n", megapixels, speedup, (sweep + 1 < sweeps) ? "," : "");
+        }
+    }
+
+    #ifdef PARALLEL_PROCESSING
+        omp_set_num_threads(default_threads);
+    #endif
+
+    if (json)
+    {
+        fprintf(json, "  ]\n}\n");
+        fclose(json);
+
+        fprintf(stdout, "\nResults written to %s !\n", bench->json_path);
+    }
+
+    return 0;
+}
@@ -0,0 +1,362 @@
+#include "chain.h"
+
+/* Define struct to store the state of a chain running on a tile */
+typedef struct chain_run
+{
+    const chain* ch;            // The chain to run
+    const void* input_rows;     // The input rows, x_size pixels each
+    int input_first_row;        // The index of the first input row
+    GDALDataType type;          // The data type of the input rows
+    void* output_rows;          // The output rows, x_size pixels each
+    const process_options* options; // The processing options
+    int x_size;                 // The width of the rows
+    int y_size;                 // The height of the image
+    int first_row;              // The first row of the tile
+    int first_column;           // The first column of the tile
+    int last_column;            // The column after the last one of the tile
+    int first_window_column;    // The first column of the window, the tile with the halo of the chain
+    int window_width;           // The width of the window
+    float** windows;            // Rolling window of each stage but the last, ring_sizes[s] rows of window_width floats
+    int* ring_sizes;            // The number of rows of each rolling window
+    int* next_rows;             // The next row each stage computes
+    int* last_rows;             // The row after the last one each stage computes
+    float* last_stage;          // The row of the last stage before its quantization
+    float* scratch;             // The row of the vertical pass of the separable kernels
+} chain_run;
+
+/**
+ * @brief Clamp a row index to the image, replicating the edge rows.
+ *
+ * @param index The index to clamp.
+ * @param size The number of rows.
+ *
+ * @return int The clamped index.
+*/
+static inline int chain_clamp_index(int index, int size)
+{
+    return (index < 0) ? 0 : ((index >= size) ? size - 1 : index);
+}
+
+/**
+ * @brief Parse a float parameter of a pointwise operation.
+ *
+ * @param text The text to parse.
+ * @param value The parsed value.
+ *
+ * @return int 0 on success, -1 if the text is not a float.
+*/
+int chain_parse_float(const char* text, float* value)
+{
+    char* end;
+
+    *value = strtof(text, &end);
+
+    return (end == text || *end != '\0') ? -1 : 0;
+}
+
+/**
+ * @brief Parse a pointwise operation: abs, scale:<factor>, offset:<value>, threshold:<value>[:<high>] or clamp:<low>:<high>.
+ *
+ * @param step The step to parse.
+ * @param op The parsed operation.
+ *
+ * @return int 1 if the step is an operation, 0 if it is not one (it is a kernel), -1 if it is an invalid operation.
+*/
+int chain_parse_op(const char* step, chain_op* op)
+{
+    char** fields = CSLTokenizeString2(step, ":", CSLT_ALLOWEMPTYTOKENS);
+    int count = CSLCount(fields);
+    int result = 1;
+
+    op->first = 0;
+    op->second = 0;
+
+    if (strcmp(fields[0], "abs") == 0)
+    {
+        op->type = CHAIN_ABS;
+        result = (count == 1) ? 1 : -1;
+    }
+    else if (strcmp(fields[0], "scale") == 0 || strcmp(fields[0], "offset") == 0)
+    {
+        op->type = (fields[0][0] == 's') ? CHAIN_SCALE : CHAIN_OFFSET;
+        result = (count == 2 && chain_parse_float(fields[1], &op->first) == 0) ? 1 : -1;
+    }
+    else if (strcmp(fields[0], "threshold") == 0)
+    {
+        op->type = CHAIN_THRESHOLD;
+        op->second = 255;
+        result = ((count == 2 || count == 3) && chain_parse_float(fields[1], &op->first) == 0 && (count == 2 || chain_parse_float(fields[2], &op->second) == 0)) ? 1 : -1;
+    }
+    else if (strcmp(fields[0], "clamp") == 0)
+    {
+        op->type = CHAIN_CLAMP;
+        result = (count == 3 && chain_parse_float(fields[1], &op->first) == 0 && chain_parse_float(fields[2], &op->second) == 0 && op->first <= op->second) ? 1 : -1;
+    }
+    else
+        result = 0;
+
+    if (result < 0)
+        fprintf(stderr, "Invalid chain operation %s !\n", step);
+
+    CSLDestroy(fields);
+
+    return result;
+}
+
+/**
+ * @brief Read the steps of a chain file, joining its lines with commas and skipping the lines starting with '#'.
+ *
+ * @param file The file to read.
+ *
+ * @return char* The steps separated by commas, to free with CPLFree.
+*/
+char* chain_read_file(FILE* file)
+{
+    char* steps = CPLStrdup("");
+    const char* line;
+
+    while ((line = CPLReadLine(file)) != NULL)
+    {
+        while (*line == ' ' || *line == '\t')
+            line++;
+
+        if (*line == '#' || *line == '\0')
+            continue;
+
+        char* joined = CPLStrdup(CPLSPrintf("%s%s%s", steps, (*steps) ? "," : "", line));
+
+        CPLFree(steps);
+        steps = joined;
+    }
+
+    CPLReadLine(NULL);
+
+    return steps;
+}
+
+chain* chain_load(const char* text)
+{
+    char* steps;
+    FILE* file = (strchr(text, ',') == NULL) ? fopen(text, "r") : NULL;
+
+    /* A single step that names a file is a chain file, a kernel file must be given with --kernel or with other steps */
+    if (file)
+    {
+        steps = chain_read_file(file);
+        fclose(file);
+    }
+    else
+        steps = CPLStrdup(text);
+
+    char** tokens = CSLTokenizeString2(steps, ",", CSLT_STRIPLEADSPACES | CSLT_STRIPENDSPACES);
+    int count = CSLCount(tokens);
+
+    CPLFree(steps);
+
+    chain* ch = (chain*) calloc(1, sizeof(chain));
+
+    ch->stages = (chain_stage*) calloc((size_t)count + 1, sizeof(chain_stage));
+    ch->count = 1;
+
+    for (int i = 0; i < count; i++)
+    {
+        chain_op op;
+        int parsed = chain_parse_op(tokens[i], &op);
+        chain_stage* stage = &ch->stages[ch->count - 1];
+
+        if (parsed > 0)
+        {
+            stage->ops = (chain_op*) realloc(stage->ops, (size_t)(stage->ops_count + 1) * sizeof(chain_op));
+            stage->ops[stage->ops_count++] = op;
+        }
+        else if (parsed == 0 && (ch->stages[ch->count].kern = kernel_load(tokens[i])) != NULL)
+        {
+            ch->radius += ch->stages[ch->count].kern->radius;
+            ch->count++;
+        }
+        else
+        {
+            CSLDestroy(tokens);
+            chain_free(ch);
+            return NULL;
+        }
+    }
+
+    CSLDestroy(tokens);
+
+    if (count == 0)
+    {
+        fprintf(stderr, "Chain %s has no steps !\n", text);
+        chain_free(ch);
+        return NULL;
+    }
+
+    return ch;
+}
+
+void chain_free(chain* ch)
+{
+    if (ch == NULL)
+        return;
+
+    for (int i = 0; i < ch->count; i++)
+    {
+        kernel_free(ch->stages[i].kern);
+        free(ch->stages[i].ops);
+    }
+
+    free(ch->stages);
+    free(ch);
+}
+
+int chain_get_column_bytes(const chain* ch)
+{
+    int rows = 1;
+
+    for (int i = 1; i < ch->count; i++)
+        rows += ch->stages[i].kern->size;
+
+    return rows * (int)sizeof(float);
+}
+
+/**
+ * @brief Apply the pointwise operations of a stage to a row.
+ *
+ * @param stage The stage.
+ * @param row The row to transform in place.
+ * @param width The width of the row.
+ *
+ * @return void.
+*/
+void chain_apply_ops(const chain_stage* stage, float* row, int width)
+{
+    for (int i = 0; i < stage->ops_count; i++)
+    {
+        const chain_op* op = &stage->ops[i];
+
+        switch (op->type)
+        {
+            case CHAIN_ABS:
+                for (int x = 0; x < width; x++)
+                    row[x] = fabsf(row[x]);
+                break;
+            case CHAIN_SCALE:
+                for (int x = 0; x < width; x++)
+                    row[x] *= op->first;
+                break;
+            case CHAIN_OFFSET:
+                for (int x = 0; x < width; x++)
+                    row[x] += op->first;
+                break;
+            case CHAIN_THRESHOLD:
+                for (int x = 0; x < width; x++)
+                    row[x] = (row[x] >= op->first) ? op->second : 0;
+                break;
+            case CHAIN_CLAMP:
+                for (int x = 0; x < width; x++)
+                    row[x] = (row[x] < op->first) ? op->first : ((row[x] > op->second) ? op->second : row[x]);
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Compute the next row of a stage, then every row of the next stages it completes, so each row
+ *        is used by the next stage before the rolling window drops it.
+ *
+ * @param run The state of the chain.
+ * @param s The stage to compute the next row of.
+ *
+ * @return void.
+*/
+void chain_compute_row(chain_run* run, int s)
+{
+    const chain_stage* stage = &run->ch->stages[s];
+    int last = (s == run->ch->count - 1);
+    int row = run->next_rows[s]++;
+    float* output = last ? run->last_stage : run->windows[s] + (size_t)(row % run->ring_sizes[s]) * (size_t)run->window_width;
+
+    if (s == 0)
+    {
+        size_t pixel = (size_t)GDALGetDataTypeSizeBytes(run->type);
+        const char* input = (const char*) run->input_rows + ((size_t)(row - run->input_first_row) * (size_t)run->x_size + (size_t)run->first_window_column) * pixel;
+
+        GDALCopyWords((void*) input, run->type, (int)pixel, output, GDT_Float32, (int)sizeof(float), run->window_width);
+    }
+    else
+    {
+        const float* rows[stage->kern->size];
+
+        for (int k = 0; k < stage->kern->size; k++)
+            rows[k] = run->windows[s - 1] + (size_t)(chain_clamp_index(row + k - stage->kern->radius, run->y_size) % run->ring_sizes[s - 1]) * (size_t)run->window_width;
+
+        apply_kern(rows, output, stage->kern, run->window_width, run->scratch);
+    }
+
+    chain_apply_ops(stage, output, run->window_width);
+
+    if (last)
+    {
+        size_t output_pixel = (size_t)GDALGetDataTypeSizeBytes(run->options->output_type);
+
+        quantize(output + (run->first_column - run->first_window_column), GDT_Float32, run->options->scale, run->options->offset, (char*) run->output_rows + ((size_t)(row - run->first_row) * (size_t)run->x_size + (size_t)run->first_column) * output_pixel, run->options->output_type, run->last_column - run->first_column);
+        return;
+    }
+
+    /* The next row of the next stage is complete once its last input row, clamped to the image, is computed */
+    int radius = run->ch->stages[s + 1].kern->radius;
+
+    while (run->next_rows[s + 1] < run->last_rows[s + 1] && chain_clamp_index(run->next_rows[s + 1] + radius, run->y_size) <= row)
+        chain_compute_row(run, s + 1);
+}
+
+void chain_filter(const chain* ch, const void* input_rows, int input_first_row, void* output_rows, int x_size, int y_size, GDALDataType type, const process_options* options, int first_row, int last_row, int first_column, int last_column)
+{
+    float* windows[ch->count];
+    int ring_sizes[ch->count];
+    int next_rows[ch->count];
+    int last_rows[ch->count];
+
+    chain_run run =
+    {
+        .ch = ch, .input_rows = input_rows, .input_first_row = input_first_row, .type = type,
+        .output_rows = output_rows, .options = options, .x_size = x_size, .y_size = y_size,
+        .first_row = first_row, .first_column = first_column, .last_column = last_column,
+        .windows = windows, .ring_sizes = ring_sizes, .next_rows = next_rows, .last_rows = last_rows
+    };
+
+    /* As for a single kernel, the window adds the halo columns of the whole chain inside the image: each stage
+       spoils the radius of its kernel on the window edges, so the columns of the tile are still right at the end */
+    run.first_window_column = (first_column > ch->radius) ? first_column - ch->radius : 0;
+    run.window_width = ((last_column + ch->radius < x_size) ? last_column + ch->radius : x_size) - run.first_window_column;
+
+    /* Each stage computes the rows the next kernel needs for the rows of the next stage */
+    next_rows[ch->count - 1] = first_row;
+    last_rows[ch->count - 1] = last_row;
+
+    for (int s = ch->count - 1; s > 0; s--)
+    {
+        int radius = ch->stages[s].kern->radius;
+
+        next_rows[s - 1] = (next_rows[s] > radius) ? next_rows[s] - radius : 0;
+        last_rows[s - 1] = (last_rows[s] + radius < y_size) ? last_rows[s] + radius : y_size;
+    }
+
+    for (int s = 0; s < ch->count - 1; s++)
+    {
+        ring_sizes[s] = ch->stages[s + 1].kern->size;
+        windows[s] = (float*) strip_alloc(ring_sizes[s] * run.window_width, GDT_Float32);
+    }
+
+    run.last_stage = (float*) strip_alloc(run.window_width, GDT_Float32);
+    run.scratch = (float*) strip_alloc(run.window_width, GDT_Float32);
+
+    while (next_rows[0] < last_rows[0])
+        chain_compute_row(&run, 0);
+
+    for (int s = 0; s < ch->count - 1; s++)
+        CPLFree(windows[s]);
+
+    CPLFree(run.last_stage);
+    CPLFree(run.scratch);
+}
@@ -0,0 +1,840 @@
+#include "convolve.h"
+
+/* Products and sums are never fused into FMA, in every version of every instruction set, so --simd only
+   changes the speed: each version rounds as the scalar one does and gives the same bits */
+#pragma GCC optimize("fp-contract=off")
+
+/**
+ * @brief Convolve the columns first to last - 1 of the rows, clamping the columns outside the rows.
+ * 
+ * @param rows The input rows.
+ * @param weights The weights, row major.
+ * @param rows_count The number of rows of the weights.
+ * @param columns_count The number of columns of the weights.
+ * @param output The output row.
+ * @param width The width of the rows.
+ * @param first The first column to convolve.
+ * @param last The column after the last one to convolve.
+ * 
+ * @return void.
+*/
+void convolve_edges(const float* const* rows, const float* weights, int rows_count, int columns_count, float* output, int width, int first, int last)
+{
+    int radius = columns_count / 2;
+
+    for (int x = first; x < last; x++)
+    {
+        float sum = 0;
+
+        for (int i = 0; i < rows_count; i++)
+            for (int j = 0; j < columns_count; j++)
+            {
+                int column = x + j - radius;
+
+                column = (column < 0) ? 0 : ((column >= width) ? width - 1 : column);
+
+                sum += weights[i * columns_count + j] * rows[i][column];
+            }
+
+        output[x] = sum;
+    }
+}
+
+/**
+ * @brief Convolve the columns first to last - 1 of the rows, all the taps of these columns must be inside the rows.
+ * 
+ * @param rows The input rows.
+ * @param weights The weights, row major.
+ * @param rows_count The number of rows of the weights.
+ * @param columns_count The number of columns of the weights.
+ * @param output The output row.
+ * @param first The first column to convolve.
+ * @param last The column after the last one to convolve.
+ * 
+ * @return void.
+*/
+void convolve_inner(const float* const* rows, const float* weights, int rows_count, int columns_count, float* output, int first, int last)
+{
+    int radius = columns_count / 2;
+
+    for (int x = first; x < last; x++)
+    {
+        float sum = 0;
+
+        for (int i = 0; i < rows_count; i++)
+            for (int j = 0; j < columns_count; j++)
+                sum += weights[i * columns_count + j] * rows[i][x + j - radius];
+
+        output[x] = sum;
+    }
+}
+
+void convolve_scalar(const float* const* rows, const float* weights, int rows_count, int columns_count, float* output, int width)
+{
+    int radius = columns_count / 2;
+    int first = (radius < width) ? radius : width;
+    int last = (width - radius > first) ? width - radius : first;
+
+    convolve_edges(rows, weights, rows_count, columns_count, output, width, 0, first);
+    convolve_inner(rows, weights, rows_count, columns_count, output, first, last);
+    convolve_edges(rows, weights, rows_count, columns_count, output, width, last, width);
+}
+
+/**
+ * @brief Get a pixel of an integer row.
+ * 
+ * @param row The row.
+ * @param type The data type of the row (GDT_Byte, GDT_UInt16 or GDT_Int16).
+ * @param index The index of the pixel.
+ * 
+ * @return int The pixel.
+*/
+static inline int get_integer_pixel(const void* row, GDALDataType type, int index)
+{
+    switch (type)
+    {
+        case GDT_Byte: return ((const unsigned char*) row)[index];
+        case GDT_UInt16: return ((const unsigned short*) row)[index];
+        default: return ((const short*) row)[index];
+    }
+}
+
+/**
+ * @brief Convolve the columns first to last - 1 of the integer rows, clamping the columns outside the rows.
+ * 
+ * @param rows The input rows.
+ * @param type The data type of the rows.
+ * @param weights The integer weights, row major.
+ * @param rows_count The number of rows of the weights.
+ * @param columns_count The number of columns of the weights.
+ * @param output The output row.
+ * @param width The width of the rows.
+ * @param first The first column to convolve.
+ * @param last The column after the last one to convolve.
+ * 
+ * @return void.
+*/
+void convolve_integer_edges(const void* const* rows, GDALDataType type, const int* weights, int rows_count, int columns_count, int* output, int width, int first, int last)
+{
+    int radius = columns_count / 2;
+
+    for (int x = first; x < last; x++)
+    {
+        int sum = 0;
+
+        for (int i = 0; i < rows_count; i++)
+            for (int j = 0; j < columns_count; j++)
+            {
+                int column = x + j - radius;
+
+                column = (column < 0) ? 0 : ((column >= width) ? width - 1 : column);
+
+                sum += weights[i * columns_count + j] * get_integer_pixel(rows[i], type, column);
+            }
+
+        output[x] = sum;
+    }
+}
+
+/**
+ * @brief Convolve the columns first to last - 1 of the integer rows, all the taps of these columns must be inside the rows.
+ * 
+ * @param rows The input rows.
+ * @param type The data type of the rows.
+ * @param weights The integer weights, row major.
+ * @param rows_count The number of rows of the weights.
+ * @param columns_count The number of columns of the weights.
+ * @param output The output row.
+ * @param first The first column to convolve.
+ * @param last The column after the last one to convolve.
+ * 
+ * @return void.
+*/
+void convolve_integer_inner(const void* const* rows, GDALDataType type, const int* weights, int rows_count, int columns_count, int* output, int first, int last)
+{
+    int radius = columns_count / 2;
+
+    for (int x = first; x < last; x++)
+    {
+        int sum = 0;
+
+        for (int i = 0; i < rows_count; i++)
+            for (int j = 0; j < columns_count; j++)
+                sum += weights[i * columns_count + j] * get_integer_pixel(rows[i], type, x + j - radius);
+
+        output[x] = sum;
+    }
+}
+
+void convolve_integer_scalar(const void* const* rows, GDALDataType type, const int* weights, int bound, int rows_count, int columns_count, int* output, int width)
+{
+    int radius = columns_count / 2;
+    int first = (radius < width) ? radius : width;
+    int last = (width - radius > first) ? width - radius : first;
+
+    (void) bound;
+
+    convolve_integer_edges(rows, type, weights, rows_count, columns_count, output, width, 0, first);
+    convolve_integer_inner(rows, type, weights, rows_count, columns_count, output, first, last);
+    convolve_integer_edges(rows, type, weights, rows_count, columns_count, output, width, last, width);
+}
+
+/**
+ * @brief Get the range of the values of an integer data type.
+ * 
+ * @param type The data type (GDT_Byte, GDT_UInt16 or GDT_Int16).
+ * @param minimum The lowest value of the type.
+ * @param maximum The highest value of the type.
+ * 
+ * @return void.
+*/
+void get_type_range(GDALDataType type, float* minimum, float* maximum)
+{
+    switch (type)
+    {
+        case GDT_Byte: *minimum = 0; *maximum = 255; break;
+        case GDT_UInt16: *minimum = 0; *maximum = 65535; break;
+        default: *minimum = -32768; *maximum = 32767; break;
+    }
+}
+
+/**
+ * @brief Round a value to the nearest integer, halfway cases away from zero as GDAL does.
+ * 
+ * @param value The value to round.
+ * 
+ * @return float The rounded value.
+*/
+static inline float round_half_away(float value)
+{
+    float truncated = truncf(value);
+    float fraction = value - truncated;
+
+    return (fraction >= 0.5f) ? truncated + 1 : ((fraction <= -0.5f) ? truncated - 1 : truncated);
+}
+
+/**
+ * @brief Store an integer already in the range of an integer data type.
+ * 
+ * @param output The output row.
+ * @param type The data type of the output row.
+ * @param index The index of the pixel.
+ * @param value The value to store.
+ * 
+ * @return void.
+*/
+static inline void set_integer_pixel(void* output, GDALDataType type, int index, int value)
+{
+    switch (type)
+    {
+        case GDT_Byte: ((unsigned char*) output)[index] = (unsigned char) value; break;
+        case GDT_UInt16: ((unsigned short*) output)[index] = (unsigned short) value; break;
+        default: ((short*) output)[index] = (short) value; break;
+    }
+}
+
+/**
+ * @brief Quantize the columns first to last - 1 of a row of sums.
+ * 
+ * @param sums The row of sums.
+ * @param sum_type The data type of the sums.
+ * @param scale The scale applied to the sums.
+ * @param offset The offset added after the scale.
+ * @param output The output row.
+ * @param output_type The data type of the output row.
+ * @param first The first column to quantize.
+ * @param last The column after the last one to quantize.
+ * 
+ * @return void.
+*/
+void quantize_columns(const void* sums, GDALDataType sum_type, float scale, float offset, void* output, GDALDataType output_type, int first, int last)
+{
+    float minimum, maximum;
+
+    get_type_range(output_type, &minimum, &maximum);
+
+    for (int x = first; x < last; x++)
+    {
+        float value;
+
+        if (sum_type == GDT_Int32 && scale == 1 && offset == 0 && output_type != GDT_Float32)
+        {
+            int sum = ((const int*) sums)[x];
+
+            set_integer_pixel(output, output_type, x, (sum < (int)minimum) ? (int)minimum : ((sum > (int)maximum) ? (int)maximum : sum));
+            continue;
+        }
+
+        value = ((sum_type == GDT_Int32) ? (float)((const int*) sums)[x] : ((const float*) sums)[x]) * scale + offset;
+
+        if (output_type == GDT_Float32)
+        {
+            ((float*) output)[x] = value;
+            continue;
+        }
+
+        /* NaN goes to the minimum, as the vector versions do */
+        value = (value > minimum) ? ((value < maximum) ? value : maximum) : minimum;
+
+        set_integer_pixel(output, output_type, x, (int)round_half_away(value));
+    }
+}
+
+void quantize_scalar(const void* sums, GDALDataType sum_type, float scale, float offset, void* output, GDALDataType output_type, int width)
+{
+    quantize_columns(sums, sum_type, scale, offset, output, output_type, 0, width);
+}
+
+#ifdef CONVOLVE_X86
+    /* The vector versions peel the edge columns, where the taps must be clamped, and run the inner columns
+       four vectors at a time: each weight is broadcast once for the four vectors and the four sums are
+       independent, which hides the latency of the additions. Each tap loads its shifted vector from the
+       row, which is in L1, instead of building it from the vectors of its neighbours. */
+
+    __attribute__((target("sse4.2")))
+    void convolve_sse42(const float* const* rows, const float* weights, int rows_count, int columns_count, float* output, int width)
+    {
+        int radius = columns_count / 2;
+        int first = (radius < width) ? radius : width;
+        int last = (width - radius > first) ? width - radius : first;
+        int x = first;
+
+        convolve_edges(rows, weights, rows_count, columns_count, output, width, 0, first);
+
+        for (; x + 16 <= last; x += 16)
+        {
+            __m128 sum0 = _mm_setzero_ps();
+            __m128 sum1 = _mm_setzero_ps();
+            __m128 sum2 = _mm_setzero_ps();
+            __m128 sum3 = _mm_setzero_ps();
+
+            for (int i = 0; i < rows_count; i++)
+            {
+                const float* row = rows[i] + x - radius;
+
+                for (int j = 0; j < columns_count; j++)
+                {
+                    __m128 weight = _mm_set1_ps(weights[i * columns_count + j]);
+
+                    sum0 = _mm_add_ps(sum0, _mm_mul_ps(weight, _mm_loadu_ps(row + j)));
+                    sum1 = _mm_add_ps(sum1, _mm_mul_ps(weight, _mm_loadu_ps(row + j + 4)));
+                    sum2 = _mm_add_ps(sum2, _mm_mul_ps(weight, _mm_loadu_ps(row + j + 8)));
+                    sum3 = _mm_add_ps(sum3, _mm_mul_ps(weight, _mm_loadu_ps(row + j + 12)));
+                }
+            }
+
+            _mm_storeu_ps(output + x, sum0);
+            _mm_storeu_ps(output + x + 4, sum1);
+            _mm_storeu_ps(output + x + 8, sum2);
+            _mm_storeu_ps(output + x + 12, sum3);
+        }
+
+        for (; x + 4 <= last; x += 4)
+        {
+            __m128 sum = _mm_setzero_ps();
+
+            for (int i = 0; i < rows_count; i++)
+                for (int j = 0; j < columns_count; j++)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[i * columns_count + j]), _mm_loadu_ps(rows[i] + x + j - radius)));
+
+            _mm_storeu_ps(output + x, sum);
+        }
+
+        convolve_inner(rows, weights, rows_count, columns_count, output, x, last);
+        convolve_edges(rows, weights, rows_count, columns_count, output, width, last, width);
+    }
+
+    __attribute__((target("avx2")))
+    void convolve_avx2(const float* const* rows, const float* weights, int rows_count, int columns_count, float* output, int width)
+    {
+        int radius = columns_count / 2;
+        int first = (radius < width) ? radius : width;
+        int last = (width - radius > first) ? width - radius : first;
+        int x = first;
+
+        convolve_edges(rows, weights, rows_count, columns_count, output, width, 0, first);
+
+        for (; x + 32 <= last; x += 32)
+        {
+            __m256 sum0 = _mm256_setzero_ps();
+            __m256 sum1 = _mm256_setzero_ps();
+            __m256 sum2 = _mm256_setzero_ps();
+            __m256 sum3 = _mm256_setzero_ps();
+
+            for (int i = 0; i < rows_count; i++)
+            {
+                const float* row = rows[i] + x - radius;
+
+                for (int j = 0; j < columns_count; j++)
+                {
+                    __m256 weight = _mm256_set1_ps(weights[i * columns_count + j]);
+
+                    sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(weight, _mm256_loadu_ps(row + j)));
+                    sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(weight, _mm256_loadu_ps(row + j + 8)));
+                    sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(weight, _mm256_loadu_ps(row + j + 16)));
+                    sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(weight, _mm256_loadu_ps(row + j + 24)));
+                }
+            }
+
+            _mm256_storeu_ps(output + x, sum0);
+            _mm256_storeu_ps(output + x + 8, sum1);
+            _mm256_storeu_ps(output + x + 16, sum2);
+            _mm256_storeu_ps(output + x + 24, sum3);
+        }
+
+        for (; x + 8 <= last; x += 8)
+        {
+            __m256 sum = _mm256_setzero_ps();
+
+            for (int i = 0; i < rows_count; i++)
+                for (int j = 0; j < columns_count; j++)
+                    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[i * columns_count + j]), _mm256_loadu_ps(rows[i] + x + j - radius)));
+
+            _mm256_storeu_ps(output + x, sum);
+        }
+
+        convolve_inner(rows, weights, rows_count, columns_count, output, x, last);
+        convolve_edges(rows, weights, rows_count, columns_count, output, width, last, width);
+    }
+
+    __attribute__((target("avx512f")))
+    void convolve_avx512(const float* const* rows, const float* weights, int rows_count, int columns_count, float* output, int width)
+    {
+        int radius = columns_count / 2;
+        int first = (radius < width) ? radius : width;
+        int last = (width - radius > first) ? width - radius : first;
+        int x = first;
+
+        convolve_edges(rows, weights, rows_count, columns_count, output, width, 0, first);
+
+        for (; x + 64 <= last; x += 64)
+        {
+            __m512 sum0 = _mm512_setzero_ps();
+            __m512 sum1 = _mm512_setzero_ps();
+            __m512 sum2 = _mm512_setzero_ps();
+            __m512 sum3 = _mm512_setzero_ps();
+
+            for (int i = 0; i < rows_count; i++)
+            {
+                const float* row = rows[i] + x - radius;
+
+                for (int j = 0; j < columns_count; j++)
+                {
+                    __m512 weight = _mm512_set1_ps(weights[i * columns_count + j]);
+
+                    sum0 = _mm512_add_ps(sum0, _mm512_mul_ps(weight, _mm512_loadu_ps(row + j)));
+                    sum1 = _mm512_add_ps(sum1, _mm512_mul_ps(weight, _mm512_loadu_ps(row + j + 16)));
+                    sum2 = _mm512_add_ps(sum2, _mm512_mul_ps(weight, _mm512_loadu_ps(row + j + 32)));
+                    sum3 = _mm512_add_ps(sum3, _mm512_mul_ps(weight, _mm512_loadu_ps(row + j + 48)));
+                }
+            }
+
+            _mm512_storeu_ps(output + x, sum0);
+            _mm512_storeu_ps(output + x + 16, sum1);
+            _mm512_storeu_ps(output + x + 32, sum2);
+            _mm512_storeu_ps(output + x + 48, sum3);
+        }
+
+        /* The last columns are done with a masked vector instead of a scalar loop */
+        for (; x < last; x += 16)
+        {
+            __mmask16 mask = (last - x >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (last - x)) - 1u);
+            __m512 sum = _mm512_setzero_ps();
+
+            for (int i = 0; i < rows_count; i++)
+                for (int j = 0; j < columns_count; j++)
+                    sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_set1_ps(weights[i * columns_count + j]), _mm512_maskz_loadu_ps(mask, rows[i] + x + j - radius)));
+
+            _mm512_mask_storeu_ps(output + x, mask, sum);
+        }
+
+        convolve_edges(rows, weights, rows_count, columns_count, output, width, last, width);
+    }
+
+    /* The integer versions sum Byte rows on 16 bits lanes when bound * 255 fits them, which doubles the
+       pixels of each vector, and any other row on 32 bits lanes. AVX-512 uses the AVX2 version, the
+       16 bits operations need AVX512BW. */
+
+    __attribute__((target("sse4.2")))
+    static inline __m128i load_integer_sse42(const void* row, GDALDataType type, int index)
+    {
+        int bytes;
+
+        switch (type)
+        {
+            case GDT_Byte:
+                memcpy(&bytes, (const unsigned char*) row + index, sizeof(int));
+                return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+            case GDT_UInt16:
+                return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*) ((const unsigned short*) row + index)));
+            default:
+                return _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*) ((const short*) row + index)));
+        }
+    }
+
+    __attribute__((target("sse4.2")))
+    void convolve_integer_sse42(const void* const* rows, GDALDataType type, const int* weights, int bound, int rows_count, int columns_count, int* output, int width)
+    {
+        int radius = columns_count / 2;
+        int first = (radius < width) ? radius : width;
+        int last = (width - radius > first) ? width - radius : first;
+        int x = first;
+
+        convolve_integer_edges(rows, type, weights, rows_count, columns_count, output, width, 0, first);
+
+        if (type == GDT_Byte && bound <= 32767 / 255)
+        {
+            for (; x + 8 <= last; x += 8)
+            {
+                __m128i sum = _mm_setzero_si128();
+
+                for (int i = 0; i < rows_count; i++)
+                    for (int j = 0; j < columns_count; j++)
+                    {
+                        __m128i pixels = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*) ((const unsigned char*) rows[i] + x + j - radius)));
+
+                        sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_set1_epi16((short) weights[i * columns_count + j]), pixels));
+                    }
+
+                _mm_storeu_si128((__m128i*) (output + x), _mm_cvtepi16_epi32(sum));
+                _mm_storeu_si128((__m128i*) (output + x + 4), _mm_cvtepi16_epi32(_mm_srli_si128(sum, 8)));
+            }
+        }
+        else
+        {
+            for (; x + 4 <= last; x += 4)
+            {
+                __m128i sum = _mm_setzero_si128();
+
+                for (int i = 0; i < rows_count; i++)
+                    for (int j = 0; j < columns_count; j++)
+                        sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_set1_epi32(weights[i * columns_count + j]), load_integer_sse42(rows[i], type, x + j - radius)));
+
+                _mm_storeu_si128((__m128i*) (output + x), sum);
+            }
+        }
+
+        convolve_integer_inner(rows, type, weights, rows_count, columns_count, output, x, last);
+        convolve_integer_edges(rows, type, weights, rows_count, columns_count, output, width, last, width);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i load_integer_avx2(const void* row, GDALDataType type, int index)
+    {
+        switch (type)
+        {
+            case GDT_Byte:
+                return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) ((const unsigned char*) row + index)));
+            case GDT_UInt16:
+                return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) ((const unsigned short*) row + index)));
+            default:
+                return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) ((const short*) row + index)));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void convolve_integer_avx2(const void* const* rows, GDALDataType type, const int* weights, int bound, int rows_count, int columns_count, int* output, int width)
+    {
+        int radius = columns_count / 2;
+        int first = (radius < width) ? radius : width;
+        int last = (width - radius > first) ? width - radius : first;
+        int x = first;
+
+        convolve_integer_edges(rows, type, weights, rows_count, columns_count, output, width, 0, first);
+
+        if (type == GDT_Byte && bound <= 32767 / 255)
+        {
+            for (; x + 16 <= last; x += 16)
+            {
+                __m256i sum = _mm256_setzero_si256();
+
+                for (int i = 0; i < rows_count; i++)
+                    for (int j = 0; j < columns_count; j++)
+                    {
+                        __m256i pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) ((const unsigned char*) rows[i] + x + j - radius)));
+
+                        sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(_mm256_set1_epi16((short) weights[i * columns_count + j]), pixels));
+                    }
+
+                _mm256_storeu_si256((__m256i*) (output + x), _mm256_cvtepi16_epi32(_mm256_castsi256_si128(sum)));
+                _mm256_storeu_si256((__m256i*) (output + x + 8), _mm256_cvtepi16_epi32(_mm256_extracti128_si256(sum, 1)));
+            }
+        }
+        else
+        {
+            for (; x + 8 <= last; x += 8)
+            {
+                __m256i sum = _mm256_setzero_si256();
+
+                for (int i = 0; i < rows_count; i++)
+                    for (int j = 0; j < columns_count; j++)
+                        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(weights[i * columns_count + j]), load_integer_avx2(rows[i], type, x + j - radius)));
+
+                _mm256_storeu_si256((__m256i*) (output + x), sum);
+            }
+        }
+
+        convolve_integer_inner(rows, type, weights, rows_count, columns_count, output, x, last);
+        convolve_integer_edges(rows, type, weights, rows_count, columns_count, output, width, last, width);
+    }
+
+    /* The quantizations scale the sums as floats, clamp them to the output range, round them halfway away
+       from zero and pack them with saturation. Integer sums with no scale nor offset go straight to the
+       saturating packs. */
+
+    __attribute__((target("sse4.2")))
+    static inline __m128i round_sse42(__m128 values, __m128 minimum, __m128 maximum)
+    {
+        values = _mm_min_ps(_mm_max_ps(values, minimum), maximum);
+
+        __m128 truncated = _mm_round_ps(values, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        __m128 fraction = _mm_sub_ps(values, truncated);
+        __m128 up = _mm_and_ps(_mm_cmpge_ps(fraction, _mm_set1_ps(0.5f)), _mm_set1_ps(1.0f));
+        __m128 down = _mm_and_ps(_mm_cmple_ps(fraction, _mm_set1_ps(-0.5f)), _mm_set1_ps(1.0f));
+
+        return _mm_cvttps_epi32(_mm_sub_ps(_mm_add_ps(truncated, up), down));
+    }
+
+    __attribute__((target("sse4.2")))
+    static inline void store_integers_sse42(__m128i low, __m128i high, void* output, GDALDataType type, int index)
+    {
+        switch (type)
+        {
+            case GDT_Byte:
+                _mm_storel_epi64((__m128i*) ((unsigned char*) output + index), _mm_packus_epi16(_mm_packs_epi32(low, high), _mm_setzero_si128()));
+                break;
+            case GDT_UInt16:
+                _mm_storeu_si128((__m128i*) ((unsigned short*) output + index), _mm_packus_epi32(low, high));
+                break;
+            default:
+                _mm_storeu_si128((__m128i*) ((short*) output + index), _mm_packs_epi32(low, high));
+                break;
+        }
+    }
+
+    __attribute__((target("sse4.2")))
+    void quantize_sse42(const void* sums, GDALDataType sum_type, float scale, float offset, void* output, GDALDataType output_type, int width)
+    {
+        int identity = (scale == 1 && offset == 0);
+        float minimum, maximum;
+        int x = 0;
+
+        get_type_range(output_type, &minimum, &maximum);
+
+        __m128 scales = _mm_set1_ps(scale);
+        __m128 offsets = _mm_set1_ps(offset);
+        __m128 minimums = _mm_set1_ps(minimum);
+        __m128 maximums = _mm_set1_ps(maximum);
+
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128 low, high;
+
+            if (sum_type == GDT_Int32)
+            {
+                __m128i integer_low = _mm_loadu_si128((const __m128i*) ((const int*) sums + x));
+                __m128i integer_high = _mm_loadu_si128((const __m128i*) ((const int*) sums + x + 4));
+
+                if (identity && output_type != GDT_Float32)
+                {
+                    store_integers_sse42(integer_low, integer_high, output, output_type, x);
+                    continue;
+                }
+
+                low = _mm_cvtepi32_ps(integer_low);
+                high = _mm_cvtepi32_ps(integer_high);
+            }
+            else
+            {
+                low = _mm_loadu_ps((const float*) sums + x);
+                high = _mm_loadu_ps((const float*) sums + x + 4);
+            }
+
+            low = _mm_add_ps(_mm_mul_ps(low, scales), offsets);
+            high = _mm_add_ps(_mm_mul_ps(high, scales), offsets);
+
+            if (output_type == GDT_Float32)
+            {
+                _mm_storeu_ps((float*) output + x, low);
+                _mm_storeu_ps((float*) output + x + 4, high);
+            }
+            else
+                store_integers_sse42(round_sse42(low, minimums, maximums), round_sse42(high, minimums, maximums), output, output_type, x);
+        }
+
+        quantize_columns(sums, sum_type, scale, offset, output, output_type, x, width);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i round_avx2(__m256 values, __m256 minimum, __m256 maximum)
+    {
+        values = _mm256_min_ps(_mm256_max_ps(values, minimum), maximum);
+
+        __m256 truncated = _mm256_round_ps(values, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        __m256 fraction = _mm256_sub_ps(values, truncated);
+        __m256 up = _mm256_and_ps(_mm256_cmp_ps(fraction, _mm256_set1_ps(0.5f), _CMP_GE_OQ), _mm256_set1_ps(1.0f));
+        __m256 down = _mm256_and_ps(_mm256_cmp_ps(fraction, _mm256_set1_ps(-0.5f), _CMP_LE_OQ), _mm256_set1_ps(1.0f));
+
+        return _mm256_cvttps_epi32(_mm256_sub_ps(_mm256_add_ps(truncated, up), down));
+    }
+
+    __attribute__((target("avx2")))
+    static inline void store_integers_avx2(__m256i values, void* output, GDALDataType type, int index)
+    {
+        __m128i low = _mm256_castsi256_si128(values);
+        __m128i high = _mm256_extracti128_si256(values, 1);
+
+        switch (type)
+        {
+            case GDT_Byte:
+                _mm_storel_epi64((__m128i*) ((unsigned char*) output + index), _mm_packus_epi16(_mm_packs_epi32(low, high), _mm_setzero_si128()));
+                break;
+            case GDT_UInt16:
+                _mm_storeu_si128((__m128i*) ((unsigned short*) output + index), _mm_packus_epi32(low, high));
+                break;
+            default:
+                _mm_storeu_si128((__m128i*) ((short*) output + index), _mm_packs_epi32(low, high));
+                break;
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void quantize_avx2(const void* sums, GDALDataType sum_type, float scale, float offset, void* output, GDALDataType output_type, int width)
+    {
+        int identity = (scale == 1 && offset == 0);
+        float minimum, maximum;
+        int x = 0;
+
+        get_type_range(output_type, &minimum, &maximum);
+
+        __m256 scales = _mm256_set1_ps(scale);
+        __m256 offsets = _mm256_set1_ps(offset);
+        __m256 minimums = _mm256_set1_ps(minimum);
+        __m256 maximums = _mm256_set1_ps(maximum);
+
+        for (; x + 8 <= width; x += 8)
+        {
+            __m256 values;
+
+            if (sum_type == GDT_Int32)
+            {
+                __m256i integers = _mm256_loadu_si256((const __m256i*) ((const int*) sums + x));
+
+                if (identity && output_type != GDT_Float32)
+                {
+                    store_integers_avx2(integers, output, output_type, x);
+                    continue;
+                }
+
+                values = _mm256_cvtepi32_ps(integers);
+            }
+            else
+                values = _mm256_loadu_ps((const float*) sums + x);
+
+            values = _mm256_add_ps(_mm256_mul_ps(values, scales), offsets);
+
+            if (output_type == GDT_Float32)
+                _mm256_storeu_ps((float*) output + x, values);
+            else
+                store_integers_avx2(round_avx2(values, minimums, maximums), output, output_type, x);
+        }
+
+        quantize_columns(sums, sum_type, scale, offset, output, output_type, x, width);
+    }
+#endif
+
+/* Define struct to store a convolution and the instruction set it needs */
+typedef struct convolve_isa
+{
+    const char* name;                           // Name of the instruction set
+    convolve_function function;                 // Convolution using the instruction set
+    convolve_integer_function integer_function; // Integer convolution using the instruction set
+    quantize_function quantize_function;        // Quantization using the instruction set
+    int (*supported)(void);                     // Does the CPU support the instruction set ?
+} convolve_isa;
+
+int scalar_supported(void)
+{
+    return 1;
+}
+
+#ifdef CONVOLVE_X86
+    int sse42_supported(void)
+    {
+        return __builtin_cpu_supports("sse4.2");
+    }
+
+    int avx2_supported(void)
+    {
+        return __builtin_cpu_supports("avx2");
+    }
+
+    int avx512_supported(void)
+    {
+        return __builtin_cpu_supports("avx512f");
+    }
+#endif
+
+/* Instruction sets from the best to the worst */
+static const convolve_isa convolve_isas[] =
+{
+    #ifdef CONVOLVE_X86
+        { "avx512", convolve_avx512, convolve_integer_avx2,  quantize_avx2,  avx512_supported },
+        { "avx2",   convolve_avx2,   convolve_integer_avx2,  quantize_avx2,  avx2_supported   },
+        { "sse4.2", convolve_sse42,  convolve_integer_sse42, quantize_sse42, sse42_supported  },
+    #endif
+    { "scalar", convolve_scalar, convolve_integer_scalar, quantize_scalar, scalar_supported }
+};
+
+/* Selected once by convolve_init, before any thread uses it */
+static const convolve_isa* selected_isa = &convolve_isas[sizeof(convolve_isas) / sizeof(convolve_isas[0]) - 1];
+
+int convolve_init(const char* isa)
+{
+    #ifdef CONVOLVE_X86
+        __builtin_cpu_init();
+    #endif
+
+    for (size_t i = 0; i < sizeof(convolve_isas) / sizeof(convolve_isas[0]); i++)
+    {
+        if (isa != NULL && strcmp(isa, "auto") != 0 && strcmp(isa, convolve_isas[i].name) != 0)
+            continue;
+
+        if (!convolve_isas[i].supported())
+        {
+            if (isa == NULL || strcmp(isa, "auto") == 0)
+                continue;
+
+            fprintf(stderr, "Instruction set %s is not supported by this CPU !\n", isa);
+            return -1;
+        }
+
+        selected_isa = &convolve_isas[i];
+
+        return 0;
+    }
+
+    fprintf(stderr, "Unknown instruction set %s !\n", isa);
+
+    return -1;
+}
+
+const char* convolve_get_isa(void)
+{
+    return selected_isa->name;
+}
+
+void convolve(const float* const* rows, const float* weights, int rows_count, int columns_count, float* output, int width)
+{
+    selected_isa->function(rows, weights, rows_count, columns_count, output, width);
+}
+
+void convolve_integer(const void* const* rows, GDALDataType type, const int* weights, int bound, int rows_count, int columns_count, int* output, int width)
+{
+    selected_isa->integer_function(rows, type, weights, bound, rows_count, columns_count, output, width);
+}
+
+void quantize(const void* sums, GDALDataType sum_type, float scale, float offset, void* output, GDALDataType output_type, int width)
+{
+    selected_isa->quantize_function(sums, sum_type, scale, offset, output, output_type, width);
+}
@@ -0,0 +1,192 @@
+#include "counters.h"
+
+/* Define struct to store a reading of the counters of a thread, as the group read format gives it */
+typedef struct counters_reading
+{
+    uint64_t count;                     // Number of counters of the group
+    uint64_t time_enabled;              // Time the group was enabled, in nanoseconds
+    uint64_t time_running;              // Time the group was counting, less than enabled when multiplexed
+    uint64_t values[COUNTER_COUNT];     // Value of each counter
+} counters_reading;
+
+static int enabled = 0;
+static atomic_int unavailable = 0;
+
+/* Events of each stage summed over the threads */
+static atomic_ullong stage_events[STAGE_COUNT][COUNTER_COUNT];
+
+/* Counters opened by every thread, closed once the report is printed */
+static int* open_fds = NULL;
+static int open_count = 0;
+
+/* Group of counters of the thread, -1 until it is opened and -2 if it can not be */
+static _Thread_local int thread_group = -1;
+static _Thread_local counters_reading thread_start;
+static _Thread_local int thread_started = 0;
+
+#ifdef __linux__
+    /**
+     * @brief Open a hardware counter of the calling thread, on any CPU, counting its user space work only.
+     *
+     * @param config The hardware event to count.
+     * @param group The leader of the group of the counter, or -1 to open a leader.
+     *
+     * @return int The file descriptor of the counter, or -1 on error.
+    */
+    int counters_open(uint64_t config, int group)
+    {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = (group == -1);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+    }
+#endif
+
+/**
+ * @brief Open the group of counters of the calling thread, once, and keep its descriptors to close them.
+ *
+ * @return int The leader of the group, or -2 if the counters can not be opened.
+*/
+int counters_open_group(void)
+{
+    #ifdef __linux__
+        const uint64_t configs[COUNTER_COUNT] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+        int fds[COUNTER_COUNT];
+        int opened = 0;
+
+        /* The counters of a group are scheduled together, so their ratios come from the same instructions */
+        for (opened = 0; opened < COUNTER_COUNT; opened++)
+            if ((fds[opened] = counters_open(configs[opened], opened ? fds[0] : -1)) < 0)
+                break;
+
+        if (opened < COUNTER_COUNT || ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0)
+        {
+            for (int i = 0; i < opened; i++)
+                close(fds[i]);
+
+            atomic_store(&unavailable, 1);
+            return -2;
+        }
+
+        #ifdef PARALLEL_PROCESSING
+            #pragma omp critical(counters)
+        #endif
+        {
+            open_fds = (int*) realloc(open_fds, sizeof(int) * (size_t)(open_count + COUNTER_COUNT));
+            memcpy(open_fds + open_count, fds, sizeof(fds));
+            open_count += COUNTER_COUNT;
+        }
+
+        return fds[0];
+    #else
+        atomic_store(&unavailable, 1);
+        return -2;
+    #endif
+}
+
+/**
+ * @brief Read the counters of the calling thread.
+ *
+ * @param reading The reading.
+ *
+ * @return int 0 on success, -1 on error.
+*/
+int counters_read(counters_reading* reading)
+{
+    return (read(thread_group, reading, sizeof(counters_reading)) == (ssize_t) sizeof(counters_reading)) ? 0 : -1;
+}
+
+void counters_enable(void)
+{
+    for (int s = 0; s < STAGE_COUNT; s++)
+        for (int e = 0; e < COUNTER_COUNT; e++)
+            atomic_init(&stage_events[s][e], 0);
+
+    enabled = 1;
+}
+
+void counters_start(void)
+{
+    if (!enabled)
+        return;
+
+    if (thread_group == -1)
+        thread_group = counters_open_group();
+
+    thread_started = (thread_group >= 0 && counters_read(&thread_start) == 0);
+}
+
+void counters_add(process_stage stage)
+{
+    counters_reading now;
+
+    if (!enabled || !thread_started || counters_read(&now) != 0)
+        return;
+
+    /* When the counters are multiplexed with other groups, the events of the time they did not count are
+       extrapolated from the time they counted */
+    uint64_t time_enabled = now.time_enabled - thread_start.time_enabled;
+    uint64_t time_running = now.time_running - thread_start.time_running;
+    double scale = (time_running > 0 && time_enabled > time_running) ? (double) time_enabled / (double) time_running : 1;
+
+    for (int e = 0; e < COUNTER_COUNT; e++)
+        atomic_fetch_add_explicit(&stage_events[stage][e], (unsigned long long)((double)(now.values[e] - thread_start.values[e]) * scale), memory_order_relaxed);
+
+    thread_started = 0;
+}
+
+void counters_print(FILE* file, unsigned long long pixels)
+{
+    unsigned long long events[STAGE_COUNT][COUNTER_COUNT];
+    int missing = atomic_load(&unavailable);
+    int rank = 0;
+
+    enabled = 0;
+
+    for (int s = 0; s < STAGE_COUNT; s++)
+        for (int e = 0; e < COUNTER_COUNT; e++)
+            events[s][e] = atomic_load_explicit(&stage_events[s][e], memory_order_relaxed);
+
+    for (int i = 0; i < open_count; i++)
+        close(open_fds[i]);
+
+    free(open_fds);
+    open_fds = NULL;
+    open_count = 0;
+
+    #ifdef MPI_PROCESSING
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+        MPI_Allreduce(MPI_IN_PLACE, events, STAGE_COUNT * COUNTER_COUNT, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &pixels, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &missing, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    #endif
+
+    if (rank != 0)
+        return;
+
+    if (missing)
+        fprintf(stderr, "Hardware counters are not available on some threads, check perf_event_paranoid !\n");
+
+    fprintf(file, "\nHardware counters (%llu pixels):\n", pixels);
+    fprintf(file, "\n  Stage           Cycles    Instructions    IPC      LLC misses  LLC/pixel  Branch misses  Branch/pixel\n");
+
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        unsigned long long* stage = events[s];
+        double ipc = stage[COUNTER_CYCLES] ? (double) stage[COUNTER_INSTRUCTIONS] / (double) stage[COUNTER_CYCLES] : 0;
+        double llc = pixels ? (double) stage[COUNTER_LLC_MISSES] / (double) pixels : 0;
+        double branch = pixels ? (double) stage[COUNTER_BRANCH_MISSES] / (double) pixels : 0;
+
+        fprintf(file, "  %-6s  %14llu  %14llu  %5.2f  %14llu  %9.4f  %13llu  %12.4f\n", stats_get_stage_name((process_stage)s), stage[COUNTER_CYCLES], stage[COUNTER_INSTRUCTIONS], ipc, stage[COUNTER_LLC_MISSES], llc, stage[COUNTER_BRANCH_MISSES], branch);
+    }
+}
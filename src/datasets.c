@@ -0,0 +1,119 @@
+#include "datasets.h"
+
+#ifdef PARALLEL_PROCESSING
+    dataset_pool* dataset_pool_open(GDALDatasetH dataset, GDALAccess access, int shared)
+    {
+        dataset_pool* pool = (dataset_pool*) malloc(sizeof(dataset_pool));
+        const char* path = GDALGetDescription(dataset);
+
+        /* A pool opened inside a parallel region, as by the tasks of a batch, serves the threads of its team */
+        pool->count = omp_in_parallel() ? omp_get_num_threads() : omp_get_max_threads();
+        pool->handles = (GDALDatasetH*) calloc((size_t)pool->count, sizeof(GDALDatasetH));
+        pool->handles[0] = dataset;
+        /* A dataset without a file, as a MEM dataset over the memory of a caller, can not be opened again */
+        pool->shared = shared || pool->count == 1 || *path == '\0';
+
+        omp_init_lock(&pool->mutex);
+
+        for (int i = 1; i < pool->count && !pool->shared; i++)
+        {
+            if ((pool->handles[i] = GDALOpen(path, access)) == NULL)
+            {
+                fprintf(stderr, "Failed on open handle %d on %s, sharing one handle !\n", i, path);
+
+                for (int j = 1; j < i; j++)
+                    GDALClose(pool->handles[j]);
+
+                pool->shared = 1;
+            }
+        }
+
+        if (pool->shared)
+            pool->count = 1;
+
+        return pool;
+    }
+
+    void dataset_pool_close(dataset_pool* pool)
+    {
+        for (int i = 1; i < pool->count; i++)
+            GDALClose(pool->handles[i]);
+
+        omp_destroy_lock(&pool->mutex);
+
+        free(pool->handles);
+        free(pool);
+    }
+
+    GDALDatasetH dataset_pool_acquire(dataset_pool* pool)
+    {
+        if (pool->shared)
+        {
+            double start_time = stats_now();
+
+            omp_set_lock(&pool->mutex);
+            stats_add_lock_wait(start_time);
+
+            return pool->handles[0];
+        }
+
+        /* Tasks are tied and GDAL calls have no task scheduling point, so no other task of this thread
+           uses the handle until the call returns */
+        return pool->handles[omp_get_thread_num()];
+    }
+
+    void dataset_pool_release(dataset_pool* pool)
+    {
+        if (pool->shared)
+            omp_unset_lock(&pool->mutex);
+    }
+#endif
+
+int dataset_supports_block_rewrite(GDALDatasetH dataset)
+{
+    const char* compression = GDALGetMetadataItem(dataset, "COMPRESSION", "IMAGE_STRUCTURE");
+
+    return compression == NULL || strcasecmp(compression, "NONE") == 0;
+}
+
+int dataset_supports_parallel_write(GDALDatasetH dataset)
+{
+    const char* interleave = GDALGetMetadataItem(dataset, "INTERLEAVE", "IMAGE_STRUCTURE");
+
+    if (!dataset_supports_block_rewrite(dataset))
+        return 0;
+
+    return GDALGetRasterCount(dataset) == 1 || (interleave != NULL && strcasecmp(interleave, "BAND") == 0);
+}
+
+CPLVirtualMem* dataset_map_band(GDALDatasetH dataset, int band_index, GDALDataType type, size_t* line_space)
+{
+    GDALRasterBandH band = GDALGetRasterBand(dataset, band_index);
+    char** map_options = NULL;
+    CPLVirtualMem* mapping;
+    GIntBig band_line_space;
+    int pixel_space;
+
+    if (band == NULL || GDALGetRasterDataType(band) != type)
+        return NULL;
+
+    /* Only a mapping of the file itself, the default implementation reads the pages through the block cache */
+    map_options = CSLSetNameValue(map_options, "USE_DEFAULT_IMPLEMENTATION", "NO");
+
+    mapping = GDALGetVirtualMemAuto(band, GF_Read, &pixel_space, &band_line_space, map_options);
+
+    CSLDestroy(map_options);
+
+    if (mapping == NULL)
+        return NULL;
+
+    if (pixel_space != GDALGetDataTypeSizeBytes(type) || band_line_space < (GIntBig)pixel_space * GDALGetRasterBandXSize(band))
+    {
+        CPLVirtualMemFree(mapping);
+        return NULL;
+    }
+
+    *line_space = (size_t)band_line_space;
+
+    return mapping;
+}
@@ -0,0 +1,89 @@
+#include "generate.h"
+
+/**
+ * @brief Hash the position of a pixel with the seed (the murmur3 finalizer on the combined words).
+ *
+ * @param x The column of the pixel.
+ * @param y The row of the pixel.
+ * @param band The band of the pixel.
+ * @param seed The seed.
+ *
+ * @return uint32_t The hash of the pixel.
+*/
+static inline uint32_t generate_hash(uint32_t x, uint32_t y, uint32_t band, uint32_t seed)
+{
+    uint32_t h = seed ^ (x * 0x9E3779B1u) ^ (y * 0x85EBCA77u) ^ (band * 0xC2B2AE3Du);
+
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+double generate_value(int x, int y, int band, int x_size, int y_size, uint32_t seed)
+{
+    double gradient = (double)(x + y) / (double)(x_size + y_size);
+    int square = ((x >> 6) + (y >> 6) + band) & 1;
+    double noise = (double)(generate_hash((uint32_t)x, (uint32_t)y, (uint32_t)band, seed) >> 8) / 16777216.0;
+
+    return 0.25 * gradient + 0.5 * square + 0.25 * noise;
+}
+
+double generate_file(const char* output_path, const generate_options* generate, char** create_options)
+{
+    int x_size = generate->x_size;
+    int y_size = generate->y_size;
+    int bands = generate->bands;
+    double scale = (generate->type == GDT_UInt16 || generate->type == GDT_Int16) ? 65535.0 : 255.0;
+    double offset = (generate->type == GDT_Int16) ? -32768.0 : 0.0;
+
+    double start_time = stats_now();
+
+    GDALDatasetH dataset = GDALCreate(GDALGetDriverByName("GTiff"), output_path, x_size, y_size, bands, generate->type, create_options);
+
+    if (dataset == NULL)
+    {
+        fprintf(stderr, "Failed on create dataset %s !\n", output_path);
+        return -1;
+    }
+
+    /* Chunks of whole blocks, all the bands of a chunk written by one call, so a pixel interleaved or
+       compressed block is encoded once */
+    int chunk_rows = get_chunk_rows(GDALGetRasterBand(dataset, 1), y_size);
+    float* rows = (float*) strip_alloc(x_size * chunk_rows * bands, GDT_Float32);
+
+    for (int first_row = 0; first_row < y_size; first_row += chunk_rows)
+    {
+        int rows_count = (first_row + chunk_rows > y_size) ? y_size - first_row : chunk_rows;
+
+        #ifdef PARALLEL_PROCESSING
+            #pragma omp parallel for collapse(2) schedule(static)
+        #endif
+        for (int band = 0; band < bands; band++)
+        {
+            for (int row = 0; row < rows_count; row++)
+            {
+                float* output = rows + ((size_t)band * (size_t)rows_count + (size_t)row) * (size_t)x_size;
+
+                for (int x = 0; x < x_size; x++)
+                    output[x] = (float)(generate_value(x, first_row + row, band, x_size, y_size, generate->seed) * scale + offset);
+            }
+        }
+
+        if (GDALDatasetRasterIO(dataset, GF_Write, 0, first_row, x_size, rows_count, rows, x_size, rows_count, GDT_Float32, bands, NULL, 0, 0, 0) != CE_None)
+        {
+            fprintf(stderr, "Failed write lines %d-%d of %s !\n", first_row, first_row + rows_count - 1, output_path);
+            CPLFree(rows);
+            GDALClose(dataset);
+            return -1;
+        }
+    }
+
+    CPLFree(rows);
+    GDALClose(dataset);
+
+    return stats_now() - start_time;
+}
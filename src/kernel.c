@@ -0,0 +1,280 @@
+#include "kernel.h"
+
+/* Define the relative tolerance used to decide if a kernel is separable */
+#define SEPARABLE_TOLERANCE 1e-6f
+
+/* Define struct to store the built-in kernels */
+typedef struct builtin_kernel
+{
+    const char* name;      // Name of the kernel
+    int size;              // Width and height of the kernel
+    float divisor;         // Divisor applied to all the weights
+    const float* weights;  // size * size weights, row major
+} builtin_kernel;
+
+static const float edge_weights[] =
+{
+    -1, -1, -1,
+    -1,  8, -1,
+    -1, -1, -1
+};
+
+static const float sobel_weights[] =
+{
+    -1, 0, 1,
+    -2, 0, 2,
+    -1, 0, 1
+};
+
+static const float gaussian5_weights[] =
+{
+    1,  4,  6,  4, 1,
+    4, 16, 24, 16, 4,
+    6, 24, 36, 24, 6,
+    4, 16, 24, 16, 4,
+    1,  4,  6,  4, 1
+};
+
+static const float box7_weights[] =
+{
+    1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1
+};
+
+static const builtin_kernel builtin_kernels[] =
+{
+    { "edge",      3, 1,   edge_weights      },
+    { "sobel",     3, 1,   sobel_weights     },
+    { "gaussian5", 5, 256, gaussian5_weights },
+    { "box7",      7, 49,  box7_weights      }
+};
+
+/**
+ * @brief Detect if a kernel is the outer product of a column and a row vector and, if so, store both vectors.
+ * 
+ * @param kern The kernel to check.
+ * 
+ * @return void.
+*/
+void detect_separable(kernel* kern)
+{
+    int size = kern->size;
+    int pivot = 0;
+
+    for (int i = 1; i < size * size; i++)
+        if (fabsf(kern->weights[i]) > fabsf(kern->weights[pivot]))
+            pivot = i;
+
+    float pivot_weight = kern->weights[pivot];
+
+    kern->separable = 0;
+
+    if (size < 3 || pivot_weight == 0)
+        return;
+
+    /* With pivot (p, q), column[i] = w[i][q] and row[j] = w[p][j] / w[p][q] reproduce w when it has rank one */
+    int p = pivot / size;
+    int q = pivot % size;
+
+    for (int i = 0; i < size; i++)
+    {
+        kern->column[i] = kern->weights[i * size + q];
+        kern->row[i] = kern->weights[p * size + i] / pivot_weight;
+    }
+
+    for (int i = 0; i < size; i++)
+        for (int j = 0; j < size; j++)
+            if (fabsf(kern->weights[i * size + j] - kern->column[i] * kern->row[j]) > SEPARABLE_TOLERANCE * fabsf(pivot_weight))
+                return;
+
+    kern->separable = 1;
+}
+
+/**
+ * @brief Detect if all the weights of a kernel are integers and, if so, store them as integers.
+ * 
+ * @param kern The kernel to check.
+ * 
+ * @return void.
+*/
+void detect_integer(kernel* kern)
+{
+    int count = kern->size * kern->size;
+    float bound = 0;
+
+    kern->integers = NULL;
+    kern->bound = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (kern->weights[i] != floorf(kern->weights[i]))
+            return;
+
+        bound += fabsf(kern->weights[i]);
+    }
+
+    /* Larger weights would overflow the 32 bits sums of any integer pixel */
+    if (bound * 65535.0f >= 2147483647.0f)
+        return;
+
+    kern->integers = (int*) malloc(sizeof(int) * (size_t)count);
+    kern->bound = (int)bound;
+
+    for (int i = 0; i < count; i++)
+        kern->integers[i] = (int)kern->weights[i];
+}
+
+/**
+ * @brief Read all the numbers of a kernel file, skipping comment lines.
+ * 
+ * @param file The file to read.
+ * @param count The number of values read.
+ * 
+ * @return float* The values read (must be freed) or NULL on error.
+*/
+float* read_kernel_values(FILE* file, int* count)
+{
+    char line[4096];
+    int capacity = 64;
+    float* values = (float*) malloc(sizeof(float) * (size_t)capacity);
+
+    *count = 0;
+
+    while (fgets(line, sizeof(line), file))
+    {
+        char* it = line;
+
+        while (isspace((unsigned char)*it))
+            it++;
+
+        if (*it == '#')
+            continue;
+
+        while (*it)
+        {
+            char* end;
+            float value = strtof(it, &end);
+
+            if (end == it)
+            {
+                if (isspace((unsigned char)*it))
+                {
+                    it++;
+                    continue;
+                }
+
+                free(values);
+                return NULL;
+            }
+
+            if (*count == capacity)
+            {
+                capacity *= 2;
+                values = (float*) realloc(values, sizeof(float) * (size_t)capacity);
+            }
+
+            values[(*count)++] = value;
+            it = end;
+        }
+    }
+
+    return values;
+}
+
+kernel* kernel_alloc(int size, const float* weights)
+{
+    if (size < 1 || size % 2 == 0)
+        return NULL;
+
+    kernel* kern = (kernel*) malloc(sizeof(kernel));
+
+    kern->size = size;
+    kern->radius = size / 2;
+
+    kern->weights = (float*) malloc(sizeof(float) * (size_t)(size * size));
+    kern->column = (float*) malloc(sizeof(float) * (size_t)size);
+    kern->row = (float*) malloc(sizeof(float) * (size_t)size);
+
+    memcpy(kern->weights, weights, sizeof(float) * (size_t)(size * size));
+
+    detect_separable(kern);
+    detect_integer(kern);
+
+    return kern;
+}
+
+kernel* kernel_load(const char* name)
+{
+    for (size_t i = 0; i < sizeof(builtin_kernels) / sizeof(builtin_kernels[0]); i++)
+    {
+        if (strcmp(builtin_kernels[i].name, name) != 0)
+            continue;
+
+        int size = builtin_kernels[i].size;
+        float weights[size * size];
+
+        for (int j = 0; j < size * size; j++)
+            weights[j] = builtin_kernels[i].weights[j] / builtin_kernels[i].divisor;
+
+        return kernel_alloc(size, weights);
+    }
+
+    FILE* file = fopen(name, "r");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed on open kernel %s !\n", name);
+        return NULL;
+    }
+
+    int count;
+    float* values = read_kernel_values(file, &count);
+
+    fclose(file);
+
+    if (values == NULL || count < 2)
+    {
+        fprintf(stderr, "Invalid kernel file %s !\n", name);
+        free(values);
+        return NULL;
+    }
+
+    int size = (int)values[0];
+    kernel* kern = NULL;
+
+    if (size < 1 || size % 2 == 0 || (float)size != values[0])
+        fprintf(stderr, "Invalid kernel size %g in %s, it must be odd !\n", (double)values[0], name);
+    else if (count != size * size + 1 && count != size * size + 2)
+        fprintf(stderr, "Invalid kernel file %s: expected %d weights, found %d !\n", name, size * size, count - 1);
+    else if (count == size * size + 2 && values[count - 1] == 0)
+        fprintf(stderr, "Invalid kernel file %s: divisor can not be zero !\n", name);
+    else
+    {
+        if (count == size * size + 2)
+            for (int i = 1; i <= size * size; i++)
+                values[i] /= values[count - 1];
+
+        kern = kernel_alloc(size, values + 1);
+    }
+
+    free(values);
+
+    return kern;
+}
+
+void kernel_free(kernel* kern)
+{
+    if (kern == NULL)
+        return;
+
+    free(kern->weights);
+    free(kern->column);
+    free(kern->row);
+    free(kern->integers);
+    free(kern);
+}
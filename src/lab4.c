@@ -0,0 +1,256 @@
+#include "lab4.h"
+#include "main.h"
+
+/* Define struct to store a filter loaded by the caller */
+struct lab4_filter
+{
+    kernel* kern;               // Kernel applied, its radius also sizes the chunks of a chain
+    chain* ch;                  // Chain applied instead of the kernel, NULL for none
+    float scale;                // Scale applied to the sums
+    float offset;               // Offset added to the scaled sums
+    int tile_width;             // Columns of the tiles, 0 to size them to the cache
+};
+
+/**
+ * @brief Get the spacings of an image in memory, with the defaults of a compact band sequential image.
+ *
+ * @param buffer The image.
+ * @param pixel_space The bytes between two pixels of a row.
+ * @param line_space The bytes between two rows.
+ * @param band_space The bytes between two bands.
+ *
+ * @return void.
+*/
+void lab4_get_spacing(const lab4_buffer* buffer, GSpacing* pixel_space, GSpacing* line_space, GSpacing* band_space)
+{
+    *pixel_space = buffer->pixel_space ? buffer->pixel_space : GDALGetDataTypeSizeBytes(buffer->type);
+    *line_space = buffer->line_space ? buffer->line_space : *pixel_space * buffer->x_size;
+    *band_space = buffer->band_space ? buffer->band_space : *line_space * buffer->y_size;
+}
+
+/**
+ * @brief Get the first row of each band of an image in memory, if the tile engine can use its rows in
+ *        place: contiguous pixels of the data type the engine uses for it, and rows following each other.
+ *
+ * @param buffer The image.
+ * @param type The data type the engine reads or writes the image with.
+ *
+ * @return void** The first row of each band, to free, or NULL if the rows can not be used in place.
+*/
+void** lab4_get_bands(const lab4_buffer* buffer, GDALDataType type)
+{
+    GSpacing pixel_space, line_space, band_space;
+
+    lab4_get_spacing(buffer, &pixel_space, &line_space, &band_space);
+
+    if (buffer->type != type || pixel_space != GDALGetDataTypeSizeBytes(type) || line_space != pixel_space * buffer->x_size)
+        return NULL;
+
+    void** bands = (void**) malloc(sizeof(void*) * (size_t)buffer->bands);
+
+    for (int i = 0; i < buffer->bands; i++)
+        bands[i] = (char*) buffer->data + (ptrdiff_t)(band_space * i);
+
+    return bands;
+}
+
+/**
+ * @brief Wrap an image in memory in a MEM dataset, whose bands point to the memory of the caller. The
+ *        engine gets the shape of the image from it, and reads or writes it when its rows can not be used
+ *        in place.
+ *
+ * @param buffer The image.
+ *
+ * @return GDALDatasetH The dataset, or NULL on error.
+*/
+GDALDatasetH lab4_wrap_buffer(const lab4_buffer* buffer)
+{
+    GDALDriverH driver = GDALGetDriverByName("MEM");
+    GSpacing pixel_space, line_space, band_space;
+
+    lab4_get_spacing(buffer, &pixel_space, &line_space, &band_space);
+
+    GDALDatasetH dataset = (driver != NULL) ? GDALCreate(driver, "", buffer->x_size, buffer->y_size, 0, buffer->type, NULL) : NULL;
+
+    if (dataset == NULL)
+    {
+        fprintf(stderr, "Failed on create memory dataset !\n");
+        return NULL;
+    }
+
+    for (int i = 0; i < buffer->bands; i++)
+    {
+        char** band_options = NULL;
+
+        band_options = CSLSetNameValue(band_options, "DATAPOINTER", CPLSPrintf("%p", (void*)((char*) buffer->data + (ptrdiff_t)(band_space * i))));
+        band_options = CSLSetNameValue(band_options, "PIXELOFFSET", CPLSPrintf("%lld", (long long) pixel_space));
+        band_options = CSLSetNameValue(band_options, "LINEOFFSET", CPLSPrintf("%lld", (long long) line_space));
+
+        CPLErr error = GDALAddBand(dataset, buffer->type, band_options);
+
+        CSLDestroy(band_options);
+
+        if (error != CE_None)
+        {
+            fprintf(stderr, "Failed on add band %d to memory dataset !\n", i + 1);
+            GDALClose(dataset);
+            return NULL;
+        }
+    }
+
+    return dataset;
+}
+
+/**
+ * @brief Check that an image in memory can hold the output of an input of a given shape.
+ *
+ * @param output The output image.
+ * @param x_size The width of the input.
+ * @param y_size The height of the input.
+ * @param bands The band count of the input.
+ *
+ * @return int 0 if it can, -1 otherwise.
+*/
+int lab4_check_output(const lab4_buffer* output, int x_size, int y_size, int bands)
+{
+    GDALDataType type;
+
+    if (output == NULL || output->data == NULL || output->x_size != x_size || output->y_size != y_size || output->bands != bands)
+    {
+        fprintf(stderr, "Output of %dx%d pixels and %d bands expected !\n", x_size, y_size, bands);
+        return -1;
+    }
+
+    if (parse_output_type(GDALGetDataTypeName(output->type), &type) != 0)
+    {
+        fprintf(stderr, "Invalid output type: %s !\n", GDALGetDataTypeName(output->type));
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Filter a dataset into an image in memory with the tile engine, using the rows of the input and
+ *        of the output in place when they are given.
+ *
+ * @param filter The filter.
+ * @param input_dataset The input dataset.
+ * @param input_bands The first row of each input band, or NULL to read the input dataset.
+ * @param output The output image.
+ *
+ * @return double The time taken to filter the dataset, or a negative value on error.
+*/
+double lab4_run(const lab4_filter* filter, GDALDatasetH input_dataset, void** input_bands, const lab4_buffer* output)
+{
+    GDALDatasetH output_dataset = lab4_wrap_buffer(output);
+
+    if (output_dataset == NULL)
+        return -1;
+
+    void** output_bands = lab4_get_bands(output, output->type);
+
+    /* Chains only run on the tile engine, which is also the one that filters the rows in place. It runs
+       quietly, the programs embedding the library have their own logs. */
+    process_options options = { .memory_budget = 0, .output_type = output->type, .scale = filter->scale, .offset = filter->offset, .parallel_write = 0, .interleaved_read = 0, .mapped_read = 0, .create_options = NULL, .engine = ENGINE_TILES, .tile_width = filter->tile_width, .chain = filter->ch, .input_bands = input_bands, .output_bands = output_bands, .quiet = 1 };
+
+    int x_size = GDALGetRasterXSize(input_dataset);
+    int y_size = GDALGetRasterYSize(input_dataset);
+
+    double time = process_dataset_tiles(input_dataset, output_dataset, filter->kern, x_size, y_size, 0, y_size, &options);
+
+    GDALClose(output_dataset);
+    free(output_bands);
+
+    return time;
+}
+
+int lab4_init(const char* isa)
+{
+    GDALAllRegister();
+
+    return convolve_init(isa);
+}
+
+void lab4_options_default(lab4_options* options)
+{
+    *options = (lab4_options) { .kernel = NULL, .chain = NULL, .scale = 1, .offset = 0, .tile_width = 0 };
+}
+
+lab4_filter* lab4_filter_create(const lab4_options* options)
+{
+    const char* kernel_name = options->kernel ? options->kernel : "edge";
+    lab4_filter* filter = (lab4_filter*) calloc(1, sizeof(lab4_filter));
+
+    if ((filter->kern = kernel_load(kernel_name)) == NULL)
+    {
+        fprintf(stderr, "Failed on load kernel %s !\n", kernel_name);
+        free(filter);
+        return NULL;
+    }
+
+    if (options->chain && (filter->ch = chain_load(options->chain)) == NULL)
+    {
+        fprintf(stderr, "Failed on load chain %s !\n", options->chain);
+        lab4_filter_destroy(filter);
+        return NULL;
+    }
+
+    filter->scale = options->scale;
+    filter->offset = options->offset;
+    filter->tile_width = options->tile_width;
+
+    return filter;
+}
+
+void lab4_filter_destroy(lab4_filter* filter)
+{
+    if (filter == NULL)
+        return;
+
+    kernel_free(filter->kern);
+    chain_free(filter->ch);
+    free(filter);
+}
+
+double lab4_filter_buffer(const lab4_filter* filter, const lab4_buffer* input, const lab4_buffer* output)
+{
+    if (input == NULL || input->data == NULL || input->x_size < 1 || input->y_size < 1 || input->bands < 1)
+    {
+        fprintf(stderr, "Invalid input image !\n");
+        return -1;
+    }
+
+    if (lab4_check_output(output, input->x_size, input->y_size, input->bands) != 0)
+        return -1;
+
+    GDALDatasetH input_dataset = lab4_wrap_buffer(input);
+
+    if (input_dataset == NULL)
+        return -1;
+
+    /* The engine filters the types it reads natively from the rows in place, the others are converted by
+       GDALRasterIO to Float32 */
+    void** input_bands = lab4_get_bands(input, get_strip_type(GDALGetRasterBand(input_dataset, 1)));
+
+    double time = lab4_run(filter, input_dataset, input_bands, output);
+
+    GDALClose(input_dataset);
+    free(input_bands);
+
+    return time;
+}
+
+double lab4_filter_dataset(const lab4_filter* filter, GDALDatasetH input_dataset, const lab4_buffer* output)
+{
+    if (input_dataset == NULL || GDALGetRasterCount(input_dataset) < 1)
+    {
+        fprintf(stderr, "Invalid input dataset !\n");
+        return -1;
+    }
+
+    if (lab4_check_output(output, GDALGetRasterXSize(input_dataset), GDALGetRasterYSize(input_dataset), GDALGetRasterCount(input_dataset)) != 0)
+        return -1;
+
+    return lab4_run(filter, input_dataset, NULL, output);
+}
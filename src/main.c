@@ -1,107 +1,675 @@
 #include "main.h"
 
+/**
+ * @brief Get the number of chunks the reader may run ahead of the writer to stay within the memory budget.
+ * 
+ * @param options The processing options.
+ * @param x_size The width of the strips.
+ * @param chunk_rows The number of rows of each chunk.
+ * @param chunks The number of chunks of each band.
+ * @param bands The number of bands processed at the same time.
+ * @param input_type The data type of the input strips.
+ * @param filtered_type The data type of the filtered strips.
+ * 
+ * @return int The window in chunks (at least 2), or 0 if the memory is unbounded.
+*/
+int get_window_chunks(const process_options* options, int x_size, int chunk_rows, int chunks, int bands, GDALDataType input_type, GDALDataType filtered_type)
+{
+    if (options->memory_budget == 0)
+        return 0;
+
+    /* With a window of W chunks each band holds up to W + 1 chunks of input strips, W chunks of
+       filtered strips and the chunk buffers of one read and one write. */
+    size_t chunk_pixels = (size_t)x_size * (size_t)chunk_rows * (size_t)bands;
+    size_t input_bytes = chunk_pixels * (size_t)GDALGetDataTypeSizeBytes(input_type);
+    size_t filtered_bytes = chunk_pixels * (size_t)GDALGetDataTypeSizeBytes(filtered_type);
+    size_t fixed_bytes = 2 * input_bytes + filtered_bytes;
+    size_t window = (options->memory_budget > fixed_bytes) ? (options->memory_budget - fixed_bytes) / (input_bytes + filtered_bytes) : 0;
+
+    if (window < 2)
+    {
+        fprintf(stderr, "Memory budget too small, using %zu bytes !\n", fixed_bytes + 2 * (input_bytes + filtered_bytes));
+        window = 2;
+    }
+
+    return (window >= (size_t)chunks) ? 0 : (int)window;
+}
+
+/**
+ * @brief Get the number of rows of each chunk. A chunk is at least as high as the chunks of both datasets
+ *        and the kernel radius, so it holds the whole halo of the next one. It is made of whole blocks of
+ *        the output, so no output block is written by two handles or two ranks, and of whole blocks of the
+ *        input too when a common multiple of both block heights is at most 4 times that height. Otherwise
+ *        the reads of a chunk may start inside an input block, which only costs a second decode of it.
+ * 
+ * @param input_dataset The input dataset.
+ * @param output_dataset The output dataset.
+ * @param kern The kernel to be applied.
+ * @param y_size The height of the image.
+ * 
+ * @return int The number of rows, a multiple of the output block height unless it is y_size.
+*/
+int get_kernel_chunk_rows(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int y_size)
+{
+    int input_chunk_rows = get_chunk_rows(GDALGetRasterBand(input_dataset, 1), y_size);
+    int output_chunk_rows = get_chunk_rows(GDALGetRasterBand(output_dataset, 1), y_size);
+    int chunk_rows = (input_chunk_rows > output_chunk_rows) ? input_chunk_rows : output_chunk_rows;
+    int block_x_size, input_block_rows, output_block_rows;
+
+    GDALGetBlockSize(GDALGetRasterBand(input_dataset, 1), &block_x_size, &input_block_rows);
+    GDALGetBlockSize(GDALGetRasterBand(output_dataset, 1), &block_x_size, &output_block_rows);
+
+    input_block_rows = (input_block_rows < 1) ? 1 : input_block_rows;
+    output_block_rows = (output_block_rows < 1) ? 1 : output_block_rows;
+
+    /* Least common multiple of the block heights, by Euclid's algorithm on their greatest common divisor */
+    long long common_rows = input_block_rows;
+    long long divisor = output_block_rows;
+
+    while (divisor != 0)
+    {
+        long long rest = common_rows % divisor;
+
+        common_rows = divisor;
+        divisor = rest;
+    }
+
+    common_rows = (long long)input_block_rows / common_rows * output_block_rows;
+
+    int step = (common_rows <= 4LL * chunk_rows) ? (int)common_rows : output_block_rows;
+
+    chunk_rows = ((chunk_rows + step - 1) / step) * step;
+
+    if (chunk_rows < kern->radius)
+        chunk_rows *= (kern->radius + chunk_rows - 1) / chunk_rows;
+
+    return (chunk_rows > y_size) ? y_size : chunk_rows;
+}
+
+/**
+ * @brief Get the strips read with a chunk of a slab: the strips of the chunk, and the halo of the slab
+ *        for its first and last chunks.
+ * 
+ * @param chunk The index of the chunk in the slab.
+ * @param chunk_rows The number of rows of each chunk.
+ * @param slab_first The first strip of the slab.
+ * @param slab_last The strip after the last one of the slab.
+ * @param radius The number of halo strips of the kernel.
+ * @param y_size The height of the image.
+ * @param first_row The first strip to read.
+ * @param last_row The strip after the last one to read.
+ * 
+ * @return void.
+*/
+void get_read_rows(int chunk, int chunk_rows, int slab_first, int slab_last, int radius, int y_size, int* first_row, int* last_row)
+{
+    *first_row = slab_first + chunk * chunk_rows;
+    *last_row = (*first_row + chunk_rows > slab_last) ? slab_last : *first_row + chunk_rows;
+
+    if (*first_row == slab_first)
+        *first_row = (slab_first > radius) ? slab_first - radius : 0;
+
+    if (*last_row == slab_last)
+        *last_row = (slab_last + radius < y_size) ? slab_last + radius : y_size;
+}
+
+/**
+ * @brief Get the number of columns of the tiles of the tile engine, so the input rows a tile row is filtered
+ *        from, their float copies and its sums fit in TILE_CACHE_BYTES. With a filter chain, the rolling
+ *        windows of its stages fit in it instead.
+ * 
+ * @param kern The kernel to be applied.
+ * @param type The data type of the input rows.
+ * @param x_size The width of the image.
+ * @param options The processing options, with the width of the tiles (0 to size them to the cache) and the chain.
+ * 
+ * @return int The number of columns, a multiple of 16 unless it is the whole width.
+*/
+int get_tile_columns(const kernel* kern, GDALDataType type, int x_size, const process_options* options)
+{
+    GDALDataType sum_type = get_sum_type(kern, type);
+    int column_bytes = kern->size * GDALGetDataTypeSizeBytes(type) + GDALGetDataTypeSizeBytes(sum_type);
+    int radius = kern->radius;
+    int columns = options->tile_width;
+
+    if (sum_type == GDT_Float32 && type != GDT_Float32)
+        column_bytes += kern->size * (int)sizeof(float);
+
+    if (kern->separable)
+        column_bytes += (int)sizeof(float);
+
+    if (options->chain)
+    {
+        column_bytes = chain_get_column_bytes(options->chain);
+        radius = options->chain->radius;
+    }
+
+    if (columns == 0)
+    {
+        /* The halo columns are filtered too, then dropped */
+        columns = TILE_CACHE_BYTES / column_bytes - 2 * radius;
+        columns -= columns % 16;
+
+        if (columns < 64)
+            columns = 64;
+    }
+
+    return (columns > x_size) ? x_size : columns;
+}
+
+/**
+ * @brief Record the peak occupancy and the accesses of the strip lists of a band on the statistics.
+ *
+ * @param band_index The band of the lists, from 1.
+ * @param read_buffer The read list of the band.
+ * @param write_buffer The write list of the band.
+ *
+ * @return void.
+*/
+void add_list_stats(int band_index, strip_list* read_buffer, strip_list* write_buffer)
+{
+    unsigned long accesses = atomic_load_explicit(&read_buffer->total_access, memory_order_relaxed);
+    unsigned long misses = atomic_load_explicit(&read_buffer->misses, memory_order_relaxed);
+
+    stats_add_lists(band_index, strip_list_get_max_size(read_buffer), strip_list_get_max_size(write_buffer), accesses, misses);
+}
+
+/**
+ * @brief Map every band of the input dataset, so the read buffers borrow their strips from the mappings
+ *        and the rows are filtered in place, without a read stage.
+ * 
+ * @param input_dataset The input dataset.
+ * @param bands The number of bands to map.
+ * @param type The data type of the input strips.
+ * @param y_size The height of the image.
+ * @param read_buffer The read buffer of each band, allocated as a mapped strip list when every band is mapped.
+ * @param mappings The mapping of each band, to free once the read buffers are freed.
+ * 
+ * @return int 1 if every band is mapped, 0 otherwise and then no band is.
+*/
+int map_read_buffers(GDALDatasetH input_dataset, int bands, GDALDataType type, int y_size, strip_list** read_buffer, CPLVirtualMem** mappings)
+{
+    size_t line_space;
+
+    for (int i = 0; i < bands; i++)
+    {
+        if ((mappings[i] = dataset_map_band(input_dataset, i + 1, type, &line_space)) == NULL)
+        {
+            for (int j = 0; j < i; j++)
+            {
+                strip_free_list(read_buffer[j]);
+                CPLVirtualMemFree(mappings[j]);
+                mappings[j] = NULL;
+            }
+
+            return 0;
+        }
+
+        read_buffer[i] = strip_map_list(CPLVirtualMemGetAddr(mappings[i]), line_space, y_size);
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Get the rows of a band held in memory from a given row, so the tile engine reads or writes them in
+ *        place instead of moving them with GDALRasterIO.
+ * 
+ * @param bands The first row of each band.
+ * @param band_index The index of the band.
+ * @param x_size The width of the rows.
+ * @param type The data type of the rows.
+ * @param first_row The first row to get.
+ * 
+ * @return void* The first row.
+*/
+void* get_memory_rows(void* const* bands, int band_index, int x_size, GDALDataType type, int first_row)
+{
+    return (char*) bands[band_index - 1] + (size_t)first_row * (size_t)x_size * (size_t)GDALGetDataTypeSizeBytes(type);
+}
+
 #ifdef PARALLEL_PROCESSING
-    double process_dataset(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const int kern[3][3], int x_size, int y_size)
+    int process_dataset_graph(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int x_size, int y_size, int slab_first, int slab_last, const process_options* options)
     {
-        double start_time, end_time, elapsed_time;
+        int status = 0;
+        int chunk_rows = get_kernel_chunk_rows(input_dataset, output_dataset, kern, y_size);
+        int chunks = (slab_last - slab_first + chunk_rows - 1) / chunk_rows;
+        int bands = GDALGetRasterCount(input_dataset);
+        GDALDataType input_type = get_kernel_strip_type(kern, GDALGetRasterBand(input_dataset, 1));
+        int window = get_window_chunks(options, x_size, chunk_rows, chunks, bands, input_type, options->output_type);
 
-        start_time = omp_get_wtime();
+        /* Writes are chained, so when chunk c is read every chunk up to c - window has been filtered and
+           written: the strips held by each buffer span at most window + 1 chunks, plus the halo of the slab. */
+        int list_strips = (window ? (window + 1) * chunk_rows : slab_last - slab_first) + 2 * kern->radius;
+
+        strip_list** read_buffer = malloc(sizeof(strip_list*) * (size_t)bands);
+        strip_list** write_buffer = malloc(sizeof(strip_list*) * (size_t)bands);
+        CPLVirtualMem** mappings = calloc((size_t)bands, sizeof(CPLVirtualMem*));
+        int mapped = options->mapped_read && map_read_buffers(input_dataset, bands, input_type, y_size, read_buffer, mappings);
 
-        strip_list** read_buffer = malloc(sizeof(strip_list*) * 3);
-        strip_list** write_buffer = malloc(sizeof(strip_list*) * 3);
+        if (options->mapped_read && !mapped)
+            fprintf(stderr, "Input can not be mapped, reading it with copies !\n");
 
-        for (int i = 0; i < 3; i++)
+        for (int i = 0; i < bands; i++)
         {
-            read_buffer[i] = strip_alloc_list();
-            write_buffer[i] = strip_alloc_list();
+            if (!mapped)
+                read_buffer[i] = strip_alloc_list(list_strips);
+
+            write_buffer[i] = strip_alloc_list(list_strips);
         }
 
-        omp_lock_t dataset_input_mutex;
-        omp_lock_t dataset_output_mutex;
+        /* Dependency tokens of the task graph: one per band and chunk for each stage. Only their
+           addresses are used, by the depend clauses. The extra write token is never written, tasks
+           that do not wait for any write depend on it. */
+        char* read_done = calloc((size_t)(bands * chunks), sizeof(char));
+        char* filter_done = calloc((size_t)(bands * chunks), sizeof(char));
+        char* write_done = calloc((size_t)(bands * chunks + 1), sizeof(char));
 
-        omp_init_lock(&dataset_input_mutex);
-        omp_init_lock(&dataset_output_mutex);
+        /* Every thread reads with its own handle. Writes only get their own handles when the output blocks
+           can be rewritten in place, otherwise all the threads share the output dataset behind a lock. */
+        dataset_pool* input_pool = dataset_pool_open(input_dataset, GA_ReadOnly, 0);
+        dataset_pool* output_pool = dataset_pool_open(output_dataset, GA_Update, !options->parallel_write || !dataset_supports_parallel_write(output_dataset));
 
-        fprintf(stdout, "\nStarting process bands !\n\n");
+        fprintf(stdout, "\nStarting process %d bands !\n\n", bands);
 
-        #pragma omp parallel
+        if (window)
+            fprintf(stdout, "\nStreaming %d chunks of %d rows with a window of %d chunks !\n", chunks, chunk_rows, window);
+
+        /* Each chunk is read, filtered and written by its own task. A filter task becomes ready when
+           the chunks it needs around it are read, and a write task when its chunk is filtered and the
+           previous chunk of the band is written, so no thread ever waits for a strip. On streaming mode
+           a read task also waits for the write of the chunk a window behind it, which bounds the strips
+           in flight. With an interleaved read a single task reads the chunk of every band and completes
+           the read token of each of them. */
+        for (int chunk = 0; chunk <= chunks; chunk++)
         {
-            #pragma omp single
+            if (!mapped && options->interleaved_read && chunk < chunks)
+            {
+                int first_row, last_row;
+
+                get_read_rows(chunk, chunk_rows, slab_first, slab_last, kern->radius, y_size, &first_row, &last_row);
+
+                if (window && chunk >= window)
+                {
+                    #pragma omp task shared(status) depend(iterator(band = 0:bands), in: write_done[band * chunks + chunk - window]) depend(iterator(band = 0:bands), out: read_done[band * chunks + chunk])
+                    if (read_tiff_bands(read_buffer, input_pool, x_size, y_size, bands, input_type, first_row, last_row, kern->radius, slab_first, slab_last) != 0)
+                    {
+                        #pragma omp atomic write
+                        status = -1;
+                    }
+                }
+                else
+                {
+                    #pragma omp task shared(status) depend(iterator(band = 0:bands), out: read_done[band * chunks + chunk])
+                    {
+                        if (chunk == 0)
+                            fprintf(stdout, "\nBands READ start !\n");
+
+                        if (read_tiff_bands(read_buffer, input_pool, x_size, y_size, bands, input_type, first_row, last_row, kern->radius, slab_first, slab_last) != 0)
+                        {
+                            #pragma omp atomic write
+                            status = -1;
+                        }
+                    }
+                }
+            }
+
+            for (int band_index = 1; band_index <= bands; band_index++)
             {
-                for (int band_index = 1; band_index < 4; band_index++)
+                int band_token = (band_index - 1) * chunks;
+
+                if (!mapped && !options->interleaved_read && chunk < chunks)
                 {
-                    #pragma omp task
+                    int first_row, last_row;
+                    int window_token = (window && chunk >= window) ? band_token + chunk - window : bands * chunks;
+
+                    get_read_rows(chunk, chunk_rows, slab_first, slab_last, kern->radius, y_size, &first_row, &last_row);
+
+                    #pragma omp task shared(status) depend(in: write_done[window_token]) depend(out: read_done[band_token + chunk])
                     {
-                        fprintf(stdout, "\nBand %d READ start !\n", band_index);
-                        read_tiff(read_buffer[band_index - 1], input_dataset, &dataset_input_mutex, x_size, y_size, band_index);   
+                        if (chunk == 0)
+                            fprintf(stdout, "\nBand %d READ start !\n", band_index);
+
+                        if (read_tiff(read_buffer[band_index - 1], input_pool, x_size, y_size, band_index, input_type, first_row, last_row, kern->radius, slab_first, slab_last) != 0)
+                        {
+                            #pragma omp atomic write
+                            status = -1;
+                        }
                     }
+                }
+
+                if (chunk > 0)
+                {
+                    int filter_chunk = chunk - 1;
+                    int prev_chunk = (filter_chunk > 0) ? filter_chunk - 1 : 0;
+                    int next_chunk = (filter_chunk + 1 < chunks) ? filter_chunk + 1 : filter_chunk;
+                    int first_row = slab_first + filter_chunk * chunk_rows;
+                    int last_row = (first_row + chunk_rows > slab_last) ? slab_last : first_row + chunk_rows;
+
+                    int window_token = (mapped && window && filter_chunk >= window) ? band_token + filter_chunk - window : bands * chunks;
 
-                    #pragma omp task
+                    #pragma omp task shared(status) depend(in: read_done[band_token + prev_chunk], read_done[band_token + filter_chunk], read_done[band_token + next_chunk], write_done[window_token]) depend(out: filter_done[band_token + filter_chunk])
                     {
-                        fprintf(stdout, "\nBand %d FILTER start !\n", band_index);
-                        filter_tiff(read_buffer[band_index - 1], write_buffer[band_index - 1], x_size, y_size, band_index, kern);    
+                        if (filter_chunk == 0)
+                            fprintf(stdout, "\nBand %d FILTER start !\n", band_index);
+
+                        if (filter_tiff(read_buffer[band_index - 1], write_buffer[band_index - 1], x_size, y_size, band_index, input_type, kern, options, first_row, last_row) != 0)
+                        {
+                            #pragma omp atomic write
+                            status = -1;
+                        }
                     }
 
-                    #pragma omp task
+                    int prev_write_token = (filter_chunk > 0) ? band_token + filter_chunk - 1 : bands * chunks;
+
+                    #pragma omp task shared(status) depend(in: filter_done[band_token + filter_chunk], write_done[prev_write_token]) depend(out: write_done[band_token + filter_chunk])
                     {
-                        fprintf(stdout, "\nBand %d WRITE start !\n", band_index);
-                        write_tiff(write_buffer[band_index - 1], output_dataset, &dataset_output_mutex, x_size, y_size, band_index);    
+                        if (filter_chunk == 0)
+                            fprintf(stdout, "\nBand %d WRITE start !\n", band_index);
+
+                        if (write_tiff(write_buffer[band_index - 1], output_pool, x_size, y_size, band_index, options->output_type, first_row, last_row, options->output_first_row) != 0)
+                        {
+                            #pragma omp atomic write
+                            status = -1;
+                        }
                     }
                 }
             }
         }
 
-        omp_destroy_lock(&dataset_input_mutex);
-        omp_destroy_lock(&dataset_output_mutex);
+        #pragma omp taskwait
+
+        dataset_pool_close(input_pool);
+        dataset_pool_close(output_pool);
 
-        for (int i = 0; i < 3; i++)
+        for (int i = 0; i < bands; i++)
         {
+            if (window)
+                fprintf(stdout, "\nBand %d peak strips: read %d, write %d !\n", i + 1, strip_list_get_max_size(read_buffer[i]), strip_list_get_max_size(write_buffer[i]));
+
+            add_list_stats(i + 1, read_buffer[i], write_buffer[i]);
+
             strip_free_list(read_buffer[i]);
             strip_free_list(write_buffer[i]);
+
+            if (mappings[i])
+                CPLVirtualMemFree(mappings[i]);
         }
 
+        free(mappings);
+
+        stats_add_rows((long)(slab_last - slab_first) * bands, x_size);
+
+        free(read_done);
+        free(filter_done);
+        free(write_done);
+
         free(read_buffer);
         free(write_buffer);
 
+        return status;
+    }
+
+    double process_dataset(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int x_size, int y_size, int slab_first, int slab_last, const process_options* options)
+    {
+        double start_time, end_time, elapsed_time;
+        int status = 0;
+
+        start_time = omp_get_wtime();
+
+        #pragma omp parallel
+        {
+            #pragma omp single
+            status = process_dataset_graph(input_dataset, output_dataset, kern, x_size, y_size, slab_first, slab_last, options);
+        }
+
         end_time = omp_get_wtime();
 
+        if (status != 0)
+        {
+            fprintf(stderr, "\nFailed on process bands !\n");
+            return -1;
+        }
+
         elapsed_time = end_time - start_time;
 
         fprintf(stderr, "\nAll bands process (Execution time: %f seconds) !\n", elapsed_time);
         
         return elapsed_time;
     }
+
+    void process_dataset_tiles_graph(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int x_size, int y_size, int slab_first, int slab_last, const process_options* options)
+    {
+        int chunk_rows = get_kernel_chunk_rows(input_dataset, output_dataset, kern, y_size);
+        int chunks = (slab_last - slab_first + chunk_rows - 1) / chunk_rows;
+        int bands = GDALGetRasterCount(input_dataset);
+        GDALDataType input_type = get_strip_type(GDALGetRasterBand(input_dataset, 1));
+        int tile_columns = get_tile_columns(kern, input_type, x_size, options);
+        int radius = options->chain ? options->chain->radius : kern->radius;
+        int tiles = (x_size + tile_columns - 1) / tile_columns;
+        int window = get_window_chunks(options, x_size, chunk_rows, chunks, bands, input_type, options->output_type);
+
+        /* Input and output rows of each band and chunk, allocated by its read and filter tasks and freed
+           by its filter and write tasks */
+        void** input_rows = calloc((size_t)(bands * chunks), sizeof(void*));
+        void** output_rows = calloc((size_t)(bands * chunks), sizeof(void*));
+
+        /* Dependency tokens of the task graph, as on the strip engine */
+        char* read_done = calloc((size_t)(bands * chunks), sizeof(char));
+        char* filter_done = calloc((size_t)(bands * chunks), sizeof(char));
+        char* write_done = calloc((size_t)(bands * chunks + 1), sizeof(char));
+
+        /* Bands held in memory are filtered in place, their datasets are only used for their shape */
+        dataset_pool* input_pool = options->input_bands ? NULL : dataset_pool_open(input_dataset, GA_ReadOnly, 0);
+        dataset_pool* output_pool = options->output_bands ? NULL : dataset_pool_open(output_dataset, GA_Update, !options->parallel_write || !dataset_supports_parallel_write(output_dataset));
+
+        if (options->interleaved_read || options->mapped_read)
+            fprintf(stderr, "Interleaved and mapped reads are ignored by the tile engine !\n");
+
+        if (!options->quiet)
+            fprintf(stdout, "\nStarting process %d bands by tiles of %d columns !\n\n", bands, tile_columns);
+
+        if (window && !options->quiet)
+            fprintf(stdout, "\nStreaming %d chunks of %d rows with a window of %d chunks !\n", chunks, chunk_rows, window);
+
+        /* Each chunk of a band is read with its halo rows by one call, filtered by a task per tile of
+           columns and written by one call. The tasks of a chunk are linked like the ones of the strip
+           engine, but a chunk holds its own halo so it only waits for its own read. */
+        for (int chunk = 0; chunk < chunks; chunk++)
+        {
+            int first_row = slab_first + chunk * chunk_rows;
+            int last_row = (first_row + chunk_rows > slab_last) ? slab_last : first_row + chunk_rows;
+            int read_first = (first_row > radius) ? first_row - radius : 0;
+            int read_last = (last_row + radius < y_size) ? last_row + radius : y_size;
+
+            for (int band_index = 1; band_index <= bands; band_index++)
+            {
+                int token = (band_index - 1) * chunks + chunk;
+                int window_token = (window && chunk >= window) ? token - window : bands * chunks;
+                int prev_write_token = (chunk > 0) ? token - 1 : bands * chunks;
+
+                #pragma omp task depend(in: write_done[window_token]) depend(out: read_done[token])
+                {
+                    if (options->input_bands)
+                        input_rows[token] = get_memory_rows(options->input_bands, band_index, x_size, input_type, read_first);
+                    else
+                    {
+                        input_rows[token] = strip_alloc(x_size * (read_last - read_first), input_type);
+
+                        transfer_rows(input_rows[token], input_pool, x_size, band_index, input_type, GF_Read, read_first, read_last);
+                    }
+                }
+
+                #pragma omp task depend(in: read_done[token]) depend(out: filter_done[token])
+                {
+                    if (options->output_bands)
+                        output_rows[token] = get_memory_rows(options->output_bands, band_index, x_size, options->output_type, first_row - options->output_first_row);
+                    else
+                        output_rows[token] = strip_alloc(x_size * (last_row - first_row), options->output_type);
+
+                    #pragma omp taskloop grainsize(1)
+                    for (int tile = 0; tile < tiles; tile++)
+                    {
+                        int first_column = tile * tile_columns;
+                        int last_column = (first_column + tile_columns > x_size) ? x_size : first_column + tile_columns;
+                        double tile_start = stats_start();
+
+                        if (options->chain)
+                            chain_filter(options->chain, input_rows[token], read_first, output_rows[token], x_size, y_size, input_type, options, first_row, last_row, first_column, last_column);
+                        else
+                            filter_tile(input_rows[token], read_first, output_rows[token], x_size, y_size, input_type, kern, options, first_row, last_row, first_column, last_column);
+
+                        stats_add(STAGE_FILTER, band_index, tile_start);
+                    }
+
+                    if (!options->input_bands)
+                        CPLFree(input_rows[token]);
+                }
+
+                #pragma omp task depend(in: filter_done[token], write_done[prev_write_token]) depend(out: write_done[token])
+                {
+                    if (!options->output_bands)
+                    {
+                        transfer_rows(output_rows[token], output_pool, x_size, band_index, options->output_type, GF_Write, first_row - options->output_first_row, last_row - options->output_first_row);
+
+                        CPLFree(output_rows[token]);
+                    }
+                }
+            }
+        }
+
+        #pragma omp taskwait
+
+        if (input_pool)
+            dataset_pool_close(input_pool);
+
+        if (output_pool)
+            dataset_pool_close(output_pool);
+
+        free(read_done);
+        free(filter_done);
+        free(write_done);
+
+        free(input_rows);
+        free(output_rows);
+
+        stats_add_rows((long)(slab_last - slab_first) * bands, x_size);
+    }
+
+    double process_dataset_tiles(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int x_size, int y_size, int slab_first, int slab_last, const process_options* options)
+    {
+        double start_time, end_time, elapsed_time;
+
+        start_time = omp_get_wtime();
+
+        #pragma omp parallel
+        {
+            #pragma omp single
+            process_dataset_tiles_graph(input_dataset, output_dataset, kern, x_size, y_size, slab_first, slab_last, options);
+        }
+
+        end_time = omp_get_wtime();
+
+        elapsed_time = end_time - start_time;
+
+        if (!options->quiet)
+            fprintf(stderr, "\nAll bands process by tiles (Execution time: %f seconds) !\n", elapsed_time);
+
+        return elapsed_time;
+    }
 #else
-    double process_dataset(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const int kern[3][3], int x_size, int y_size)
+    double process_dataset(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int x_size, int y_size, int slab_first, int slab_last, const process_options* options)
     {
         clock_t start_time, end_time;
         double cpu_time_used;
 
-        fprintf(stdout, "\nStarting process bands !\n\n");
+        int chunk_rows = get_kernel_chunk_rows(input_dataset, output_dataset, kern, y_size);
+        int chunks = (slab_last - slab_first + chunk_rows - 1) / chunk_rows;
+        int bands = GDALGetRasterCount(input_dataset);
+        GDALDataType input_type = get_kernel_strip_type(kern, GDALGetRasterBand(input_dataset, 1));
+        int status = 0;
+
+        if (options->memory_budget)
+            fprintf(stderr, "Memory budget is ignored on the sequential build, it always streams one chunk at a time !\n");
+
+        if (options->parallel_write)
+            fprintf(stderr, "Parallel write is ignored on the sequential build !\n");
+
+        strip_list** read_buffer = malloc(sizeof(strip_list*) * (size_t)bands);
+        strip_list** write_buffer = malloc(sizeof(strip_list*) * (size_t)bands);
+
+        CPLVirtualMem** mappings = calloc((size_t)bands, sizeof(CPLVirtualMem*));
+        int mapped = options->mapped_read && map_read_buffers(input_dataset, bands, input_type, y_size, read_buffer, mappings);
+
+        if (options->mapped_read && !mapped)
+            fprintf(stderr, "Input can not be mapped, reading it with copies !\n");
+
+        for (int i = 0; i < bands; i++)
+        {
+            if (!mapped)
+                read_buffer[i] = strip_alloc_list(3 * chunk_rows + 2 * kern->radius);
+
+            write_buffer[i] = strip_alloc_list(chunk_rows);
+        }
+
+        fprintf(stdout, "\nStarting process %d bands !\n\n", bands);
 
         start_time = clock();
 
-        for (int band_index = 1; band_index < 4; band_index++)
+        /* Same order the parallel task graph satisfies: read a chunk of every band, then filter and write the one before it */
+        for (int chunk = 0; chunk <= chunks; chunk++)
         {
-            strip_list* read_buffer = strip_alloc_list();
-            strip_list* write_buffer = strip_alloc_list();
+            int first_row, last_row;
+            int filter_first = slab_first + (chunk - 1) * chunk_rows;
+            int filter_last = (filter_first + chunk_rows > slab_last) ? slab_last : filter_first + chunk_rows;
 
-            fprintf(stdout, "\nBand READ %d start !\n", band_index);
-            read_tiff(read_buffer, input_dataset, x_size, y_size, band_index);   
-        
-            fprintf(stdout, "\nBand FILTER %d start !\n", band_index);
-            filter_tiff(read_buffer, write_buffer, x_size, y_size, band_index, kern);    
+            get_read_rows(chunk, chunk_rows, slab_first, slab_last, kern->radius, y_size, &first_row, &last_row);
 
-            strip_free_list(read_buffer);
+            if (!mapped && options->interleaved_read && chunk < chunks && read_tiff_bands(read_buffer, input_dataset, x_size, y_size, bands, input_type, first_row, last_row, kern->radius, slab_first, slab_last) != 0)
+                status = -1;
 
-            fprintf(stdout, "\nBand WRITE %d start !\n", band_index);
-            write_tiff(write_buffer, output_dataset, x_size, y_size, band_index);    
-        
-            strip_free_list(write_buffer);
+            for (int band_index = 1; band_index <= bands; band_index++)
+            {
+                if (!mapped && !options->interleaved_read && chunk < chunks && read_tiff(read_buffer[band_index - 1], input_dataset, x_size, y_size, band_index, input_type, first_row, last_row, kern->radius, slab_first, slab_last) != 0)
+                    status = -1;
+
+                if (chunk > 0)
+                {
+                    if (filter_tiff(read_buffer[band_index - 1], write_buffer[band_index - 1], x_size, y_size, band_index, input_type, kern, options, filter_first, filter_last) != 0)
+                        status = -1;
+
+                    if (write_tiff(write_buffer[band_index - 1], output_dataset, x_size, y_size, band_index, options->output_type, filter_first, filter_last, options->output_first_row) != 0)
+                        status = -1;
+                }
+            }
+        }
+
+        for (int i = 0; i < bands; i++)
+        {
+            add_list_stats(i + 1, read_buffer[i], write_buffer[i]);
+
+            strip_free_list(read_buffer[i]);
+            strip_free_list(write_buffer[i]);
+
+            if (mappings[i])
+                CPLVirtualMemFree(mappings[i]);
         }
 
+        free(mappings);
+
+        stats_add_rows((long)(slab_last - slab_first) * bands, x_size);
+
+        free(read_buffer);
+        free(write_buffer);
+
         end_time = clock();
 
+        if (status != 0)
+        {
+            fprintf(stderr, "\nFailed on process bands !\n");
+            return -1;
+        }
+
         cpu_time_used = ((double) (end_time - start_time)) / CLOCKS_PER_SEC;
 
         fprintf(stderr, "\nAll bands process (Execution time: %f seconds) !\n", cpu_time_used);
@@ -109,98 +677,1199 @@
         return cpu_time_used;
 
     }
-#endif
-
-double process_file(const char* input_path, const char* output_path, const int kern[3][3])
-{
-    GDALDatasetH input_dataset = GDALOpen(input_path, GA_ReadOnly);
 
-    if (input_dataset == NULL) 
+    double process_dataset_tiles(GDALDatasetH input_dataset, GDALDatasetH output_dataset, const kernel* kern, int x_size, int y_size, int slab_first, int slab_last, const process_options* options)
     {
-        fprintf(stderr, "Failed on open file %s !\n", input_path);
-        exit(EXIT_FAILURE);
-    }
+        clock_t start_time, end_time;
+        double cpu_time_used;
 
-    int x_size = GDALGetRasterXSize(input_dataset);
-    int y_size = GDALGetRasterYSize(input_dataset); 
+        int chunk_rows = get_kernel_chunk_rows(input_dataset, output_dataset, kern, y_size);
+        int chunks = (slab_last - slab_first + chunk_rows - 1) / chunk_rows;
+        int bands = GDALGetRasterCount(input_dataset);
+        GDALDataType input_type = get_strip_type(GDALGetRasterBand(input_dataset, 1));
+        int tile_columns = get_tile_columns(kern, input_type, x_size, options);
+        int radius = options->chain ? options->chain->radius : kern->radius;
 
-    GDALDatasetH output_dataset = GDALCreate(GDALGetDriverByName("GTiff"), output_path, x_size, y_size, 3, GDT_Byte, NULL);
+        if (options->interleaved_read || options->mapped_read)
+            fprintf(stderr, "Interleaved and mapped reads are ignored by the tile engine !\n");
 
-    if (output_dataset == NULL)
-    {
-        fprintf(stderr, "Failed on create output dataset !\n");
-        exit(EXIT_FAILURE);
-    }
+        /* Bands held in memory are filtered in place, without these rows */
+        void* input_rows = options->input_bands ? NULL : strip_alloc(x_size * (chunk_rows + 2 * radius), input_type);
+        void* output_rows = options->output_bands ? NULL : strip_alloc(x_size * chunk_rows, options->output_type);
 
-    double time = process_dataset(input_dataset, output_dataset, kern, x_size, y_size);
+        if (!options->quiet)
+            fprintf(stdout, "\nStarting process %d bands by tiles of %d columns !\n\n", bands, tile_columns);
 
-    GDALClose(input_dataset);
-    GDALClose(output_dataset);
+        start_time = clock();
 
-    return time;
-}
+        for (int chunk = 0; chunk < chunks; chunk++)
+        {
+            int first_row = slab_first + chunk * chunk_rows;
+            int last_row = (first_row + chunk_rows > slab_last) ? slab_last : first_row + chunk_rows;
+            int read_first = (first_row > radius) ? first_row - radius : 0;
+            int read_last = (last_row + radius < y_size) ? last_row + radius : y_size;
 
-#ifdef TEST
-    void testing(const char* input_path, const char* output_path, const int kern[3][3])
-    {
-        double time[TEST];
+            for (int band_index = 1; band_index <= bands; band_index++)
+            {
+                void* chunk_input = input_rows;
+                void* chunk_output = output_rows;
 
-        for (int i = 0; i < TEST; i++)
-        {
-            fprintf(stdout, "\nStarting process %d / %d !\n", i + 1, TEST);
+                if (options->input_bands)
+                    chunk_input = get_memory_rows(options->input_bands, band_index, x_size, input_type, read_first);
+                else
+                    transfer_rows(input_rows, input_dataset, x_size, band_index, input_type, GF_Read, read_first, read_last);
 
-            time[i] = process_file(input_path, output_path, kern);
+                if (options->output_bands)
+                    chunk_output = get_memory_rows(options->output_bands, band_index, x_size, options->output_type, first_row - options->output_first_row);
 
-            fprintf(stdout, "\nEnding process %d / %d !\n", i + 1, TEST);
-        }
+                for (int first_column = 0; first_column < x_size; first_column += tile_columns)
+                {
+                    int last_column = (first_column + tile_columns > x_size) ? x_size : first_column + tile_columns;
+                    double tile_start = stats_start();
 
-        fprintf(stdout, "\n\n");
+                    if (options->chain)
+                        chain_filter(options->chain, chunk_input, read_first, chunk_output, x_size, y_size, input_type, options, first_row, last_row, first_column, last_column);
+                    else
+                        filter_tile(chunk_input, read_first, chunk_output, x_size, y_size, input_type, kern, options, first_row, last_row, first_column, last_column);
 
-        double sum = 0;
+                    stats_add(STAGE_FILTER, band_index, tile_start);
+                }
 
-        for (int i = 0; i < TEST; i++)
-        {
-            fprintf(stdout, "Time %d: %f\n", i + 1, time[i]);
-            sum += time[i];
+                if (!options->output_bands)
+                    transfer_rows(output_rows, output_dataset, x_size, band_index, options->output_type, GF_Write, first_row - options->output_first_row, last_row - options->output_first_row);
+            }
         }
 
-        fprintf(stdout, "\nTotal time: %f\n", sum);
-        fprintf(stdout, "\nAverage time: %f\n", sum / TEST);
+        CPLFree(input_rows);
+        CPLFree(output_rows);
+
+        stats_add_rows((long)(slab_last - slab_first) * bands, x_size);
+
+        end_time = clock();
+
+        cpu_time_used = ((double) (end_time - start_time)) / CLOCKS_PER_SEC;
+
+        if (!options->quiet)
+            fprintf(stderr, "\nAll bands process by tiles (Execution time: %f seconds) !\n", cpu_time_used);
+
+        return cpu_time_used;
     }
 #endif
 
-int main(int argc, char* argv[])
+GDALDatasetH create_output_dataset(GDALDatasetH input_dataset, const char* output_path, const process_options* options)
 {
-    if (argc != 3)
-    {
-        fprintf(stderr, "Invalid number of arguments: [input_path] [output_path] !\n");
-        return EXIT_FAILURE; 
-    }
+    char** create_options = CSLDuplicate(options->create_options);
 
-    GDALAllRegister();
+    /* A pixel interleaved block holds every band, so the handles of a parallel write would rewrite
+       each other's bands. One band per block keeps the blocks of each write task disjoint. */
+    if (options->parallel_write)
+        create_options = CSLSetNameValue(create_options, "INTERLEAVE", "BAND");
+
+    GDALDatasetH output_dataset = GDALCreate(GDALGetDriverByName("GTiff"), output_path, GDALGetRasterXSize(input_dataset), GDALGetRasterYSize(input_dataset), GDALGetRasterCount(input_dataset), options->output_type, create_options);
+
+    CSLDestroy(create_options);
+
+    return output_dataset;
+}
 
-    const int kern[3][3] = 
+#ifdef MPI_PROCESSING
+    /**
+     * @brief Write the rows of a slab filtered into memory on the output, by chunks of whole blocks of the output.
+     *
+     * @param slab_dataset The dataset holding the rows of the slab.
+     * @param output_dataset The output dataset.
+     * @param slab_first The row of the image held by the first row of the slab dataset.
+     * @param chunk_rows The rows written by each call, a multiple of the output block height.
+     *
+     * @return double The time taken to write the slab, or -1 on error.
+    */
+    double write_slab(GDALDatasetH slab_dataset, GDALDatasetH output_dataset, int slab_first, int chunk_rows)
     {
-        { -1, -1, -1 },
-        { -1,  8, -1 },
-        { -1, -1, -1 }
-    };
-    
-    #ifndef TEST
-        fprintf(stdout, "\nStarting process !\n");
+        double start_time = stats_now();
+        int x_size = GDALGetRasterXSize(slab_dataset);
+        int slab_rows = GDALGetRasterYSize(slab_dataset);
+        int bands = GDALGetRasterCount(slab_dataset);
+        GDALDataType type = GDALGetRasterDataType(GDALGetRasterBand(slab_dataset, 1));
+        int status = 0;
 
-        double time = process_file(argv[1], argv[2], kern);
+        /* The chunk holds the rows of band 1, then the rows of band 2 and so on */
+        strip chunk = strip_alloc(x_size * chunk_rows * bands, type);
 
-        fprintf(stdout, "\nEnding process !\n");
-        fprintf(stdout, "\nTotal time: %f\n", time);
-    #else
-        fprintf(stdout, "\nStarting test !\n");
+        for (int i = 0; i < slab_rows && status == 0; i += chunk_rows)
+        {
+            double chunk_start = stats_start();
+            int rows = (i + chunk_rows > slab_rows) ? slab_rows - i : chunk_rows;
 
-        testing(argv[1], argv[2], kern);
+            if (GDALDatasetRasterIO(slab_dataset, GF_Read, 0, i, x_size, rows, chunk, x_size, rows, type, bands, NULL, 0, 0, 0) != CE_None ||
+                GDALDatasetRasterIO(output_dataset, GF_Write, 0, slab_first + i, x_size, rows, chunk, x_size, rows, type, bands, NULL, 0, 0, 0) != CE_None)
+            {
+                fprintf(stderr, "Failed write slab lines %d-%d !\n", slab_first + i, slab_first + i + rows - 1);
+                status = -1;
+            }
 
-        fprintf(stdout, "\nEnding test !\n");
-    #endif
-    
-    return EXIT_SUCCESS;
+            stats_add(STAGE_WRITE, 0, chunk_start);
+        }
+
+        CPLFree(chunk);
+
+        return (status == 0) ? stats_now() - start_time : -1;
+    }
+
+    double process_file(const char* input_path, const char* output_path, const kernel* kern, const process_options* options)
+    {
+        GDALDatasetH output_dataset = NULL;
+        GDALDatasetH slab_dataset = NULL;
+        process_options slab_options = *options;
+        int parallel_write = 0;
+        int chunk_rows = 0;
+        double time = 0, max_time;
+        int rank, ranks;
+
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+        GDALDatasetH input_dataset = GDALOpen(input_path, GA_ReadOnly);
+
+        if (input_dataset == NULL)
+        {
+            fprintf(stderr, "Rank %d -> Failed on open file %s !\n", rank, input_path);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+
+        int x_size = GDALGetRasterXSize(input_dataset);
+        int y_size = GDALGetRasterYSize(input_dataset);
+
+        /* Rank 0 creates the output. When its blocks can be rewritten in place it is closed, which writes
+           all of them, and every rank opens it again to write its slab at the same time. Otherwise only one
+           rank can have it open: rank 0 filters into it while the other ranks filter their slab into
+           memory, then they take turns to write their slab, each one opening the output once the rank
+           before it has closed it. */
+        if (rank == 0)
+        {
+            if ((output_dataset = create_output_dataset(input_dataset, output_path, options)) == NULL)
+            {
+                fprintf(stderr, "Failed on create output dataset !\n");
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+
+            /* Slabs are made of whole chunks, which are made of whole blocks of the output (see
+               get_kernel_chunk_rows), so no block is written by two ranks. Rank 0 sizes them, the only
+               one that has the output open from the start. */
+            chunk_rows = get_kernel_chunk_rows(input_dataset, output_dataset, kern, y_size);
+
+            /* Each rank writes every band of its rows, so the blocks only need to be rewritable in place */
+            if ((parallel_write = dataset_supports_block_rewrite(output_dataset)))
+            {
+                GDALClose(output_dataset);
+                output_dataset = NULL;
+            }
+        }
+
+        MPI_Bcast(&parallel_write, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Bcast(&chunk_rows, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+        /* Each rank also reads the halo rows of its slab from the input */
+        int chunks = (y_size + chunk_rows - 1) / chunk_rows;
+        int slab_first = (int)((long)chunks * rank / ranks) * chunk_rows;
+        int slab_last = (int)((long)chunks * (rank + 1) / ranks) * chunk_rows;
+
+        if (slab_last > y_size)
+            slab_last = y_size;
+
+        fprintf(stdout, "\nRank %d of %d -> Rows %d-%d !\n", rank, ranks, slab_first, slab_last - 1);
+
+        if (parallel_write && (output_dataset = GDALOpen(output_path, GA_Update)) == NULL)
+        {
+            fprintf(stderr, "Rank %d -> Failed on open output dataset %s !\n", rank, output_path);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+
+        /* The slab held in memory starts at its first row, and takes the memory of all its filtered rows */
+        if (output_dataset == NULL && slab_first < slab_last)
+        {
+            if ((slab_dataset = GDALCreate(GDALGetDriverByName("MEM"), "", x_size, slab_last - slab_first, GDALGetRasterCount(input_dataset), options->output_type, NULL)) == NULL)
+            {
+                fprintf(stderr, "Rank %d -> Failed on create memory dataset of rows %d-%d !\n", rank, slab_first, slab_last - 1);
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+
+            slab_options.output_first_row = slab_first;
+        }
+
+        GDALDatasetH filter_dataset = slab_dataset ? slab_dataset : output_dataset;
+
+        if (slab_first < slab_last)
+            time = (options->engine == ENGINE_TILES) ? process_dataset_tiles(input_dataset, filter_dataset, kern, x_size, y_size, slab_first, slab_last, &slab_options) : process_dataset(input_dataset, filter_dataset, kern, x_size, y_size, slab_first, slab_last, &slab_options);
+
+        if (!parallel_write && rank > 0)
+        {
+            MPI_Recv(NULL, 0, MPI_INT, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+            if ((output_dataset = GDALOpen(output_path, GA_Update)) == NULL)
+            {
+                fprintf(stderr, "Rank %d -> Failed on open output dataset %s !\n", rank, output_path);
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+
+            if (slab_dataset)
+            {
+                double write_time = (time < 0) ? -1 : write_slab(slab_dataset, output_dataset, slab_first, chunk_rows);
+
+                time = (write_time < 0) ? -1 : time + write_time;
+
+                GDALClose(slab_dataset);
+            }
+        }
+
+        GDALClose(output_dataset);
+
+        if (!parallel_write && rank + 1 < ranks)
+            MPI_Send(NULL, 0, MPI_INT, rank + 1, 0, MPI_COMM_WORLD);
+
+        GDALClose(input_dataset);
+
+        /* The file is done when the slowest rank is, and failed when any rank did */
+        int failed = (time < 0);
+
+        MPI_Allreduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+        return failed ? -1 : max_time;
+    }
+#else
+    double process_file(const char* input_path, const char* output_path, const kernel* kern, const process_options* options)
+    {
+        GDALDatasetH input_dataset = GDALOpen(input_path, GA_ReadOnly);
+
+        if (input_dataset == NULL) 
+        {
+            fprintf(stderr, "Failed on open file %s !\n", input_path);
+            exit(EXIT_FAILURE);
+        }
+
+        int x_size = GDALGetRasterXSize(input_dataset);
+        int y_size = GDALGetRasterYSize(input_dataset); 
+
+        GDALDatasetH output_dataset = create_output_dataset(input_dataset, output_path, options);
+
+        if (output_dataset == NULL)
+        {
+            fprintf(stderr, "Failed on create output dataset !\n");
+            exit(EXIT_FAILURE);
+        }
+
+        #ifdef PARALLEL_PROCESSING
+            /* Closing the new dataset writes all its blocks, so the handles opened again in update mode
+               rewrite them in place instead of appending them at the same time */
+            if (options->parallel_write && dataset_supports_parallel_write(output_dataset))
+            {
+                GDALClose(output_dataset);
+
+                if ((output_dataset = GDALOpen(output_path, GA_Update)) == NULL)
+                {
+                    fprintf(stderr, "Failed on open output dataset %s !\n", output_path);
+                    exit(EXIT_FAILURE);
+                }
+            }
+        #endif
+
+        double time = (options->engine == ENGINE_TILES) ? process_dataset_tiles(input_dataset, output_dataset, kern, x_size, y_size, 0, y_size, options) : process_dataset(input_dataset, output_dataset, kern, x_size, y_size, 0, y_size, options);
+
+        GDALClose(input_dataset);
+        GDALClose(output_dataset);
+
+        return time;
+    }
+#endif
+
+/**
+ * @brief Parse a memory size with an optional K, M or G suffix (MiB if no suffix is given).
+ * 
+ * @param text The text to parse.
+ * @param bytes The parsed size in bytes.
+ * 
+ * @return int 0 on success, -1 if the text is not a valid size.
+*/
+int parse_memory_size(const char* text, size_t* bytes)
+{
+    char* end;
+    double value = strtod(text, &end);
+    double unit = 1024.0 * 1024.0;
+
+    if (end == text || value < 0)
+        return -1;
+
+    switch (*end)
+    {
+        case 'k': case 'K': unit = 1024.0; end++; break;
+        case 'm': case 'M': unit = 1024.0 * 1024.0; end++; break;
+        case 'g': case 'G': unit = 1024.0 * 1024.0 * 1024.0; end++; break;
+        default: break;
+    }
+
+    if (*end != '\0')
+        return -1;
+
+    *bytes = (size_t)(value * unit);
+
+    return 0;
+}
+
+int parse_output_type(const char* text, GDALDataType* type)
+{
+    const GDALDataType types[] = { GDT_Byte, GDT_UInt16, GDT_Int16, GDT_Float32 };
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+        if (strcasecmp(text, GDALGetDataTypeName(types[i])) == 0)
+        {
+            *type = types[i];
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+int parse_float(const char* text, float* value)
+{
+    char* end;
+
+    *value = strtof(text, &end);
+
+    return (end == text || *end != '\0' || !isfinite(*value)) ? -1 : 0;
+}
+
+/**
+ * @brief Parse a block size, <width>x<height> for tiles or <height> for strips.
+ * 
+ * @param text The text to parse.
+ * @param x_size The parsed width, 0 if only the height is given.
+ * @param y_size The parsed height.
+ * 
+ * @return int 0 on success, -1 if the text is not a valid block size.
+*/
+int parse_block_size(const char* text, int* x_size, int* y_size)
+{
+    char* end;
+    long first = strtol(text, &end, 10);
+    long second;
+
+    if (end == text || first < 1 || first > 65536)
+        return -1;
+
+    if (*end == '\0')
+    {
+        *x_size = 0;
+        *y_size = (int)first;
+        return 0;
+    }
+
+    if (*end != 'x' && *end != 'X')
+        return -1;
+
+    text = end + 1;
+    second = strtol(text, &end, 10);
+
+    if (end == text || *end != '\0' || second < 1 || second > 65536)
+        return -1;
+
+    *x_size = (int)first;
+    *y_size = (int)second;
+
+    return 0;
+}
+
+const char* parse_choice(const char* text, const char* const* choices)
+{
+    for (int i = 0; choices[i] != NULL; i++)
+        if (strcasecmp(text, choices[i]) == 0)
+            return choices[i];
+
+    return NULL;
+}
+
+/**
+ * @brief Parse a positive count.
+ * 
+ * @param text The text to parse.
+ * @param value The parsed count.
+ * @param minimum The smallest valid count.
+ * 
+ * @return int 0 on success, -1 if the text is not a count of at least minimum.
+*/
+int parse_count(const char* text, int* value, int minimum)
+{
+    char* end;
+    long count = strtol(text, &end, 10);
+
+    if (end == text || *end != '\0' || count < minimum || count > 1000000)
+        return -1;
+
+    *value = (int)count;
+
+    return 0;
+}
+
+/**
+ * @brief Parse a list of thread counts separated by commas, e.g. 1,2,4,8.
+ * 
+ * @param text The text to parse.
+ * @param threads The parsed thread counts, to free with free.
+ * @param count The number of thread counts.
+ * 
+ * @return int 0 on success, -1 if the text is not a valid list.
+*/
+int parse_threads(const char* text, int** threads, int* count)
+{
+    char** fields = CSLTokenizeString2(text, ",", CSLT_ALLOWEMPTYTOKENS);
+    int result = 0;
+
+    *count = CSLCount(fields);
+    *threads = (int*) malloc(sizeof(int) * (size_t)(*count + 1));
+
+    for (int i = 0; i < *count && result == 0; i++)
+        result = parse_count(fields[i], &(*threads)[i], 1);
+
+    CSLDestroy(fields);
+
+    if (result != 0 || *count == 0)
+    {
+        free(*threads);
+        *threads = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check the creation options of the output against each other and the output type, and enable
+ *        the multithreaded encoding of compressed outputs when no thread count is given.
+ * 
+ * @param options The processing options.
+ * 
+ * @return int 0 on success, -1 if the creation options can not be used together.
+*/
+int check_create_options(process_options* options)
+{
+    const char* tiled = CSLFetchNameValue(options->create_options, "TILED");
+    const char* block_x_size = CSLFetchNameValue(options->create_options, "BLOCKXSIZE");
+    const char* block_y_size = CSLFetchNameValue(options->create_options, "BLOCKYSIZE");
+    const char* compress = CSLFetchNameValue(options->create_options, "COMPRESS");
+    const char* predictor = CSLFetchNameValue(options->create_options, "PREDICTOR");
+    int compressed = compress != NULL && strcasecmp(compress, "NONE") != 0;
+
+    if (tiled == NULL && block_x_size != NULL)
+    {
+        fprintf(stderr, "Block width needs --tiled, strips only take a height !\n");
+        return -1;
+    }
+
+    if (tiled != NULL && ((block_x_size != NULL && atoi(block_x_size) % 16 != 0) || (block_y_size != NULL && atoi(block_y_size) % 16 != 0)))
+    {
+        fprintf(stderr, "Tile width and height must be multiples of 16 !\n");
+        return -1;
+    }
+
+    if (tiled != NULL && block_x_size == NULL && block_y_size != NULL)
+    {
+        fprintf(stderr, "Tiles need a block size of <width>x<height> !\n");
+        return -1;
+    }
+
+    /* Any block height is kept: get_kernel_chunk_rows rounds the chunks up to whole blocks of the output, so
+       the writes of two threads or two ranks never share a block whatever the block height of the input */
+
+    if (predictor != NULL && !compressed)
+    {
+        fprintf(stderr, "Predictor needs --compress !\n");
+        return -1;
+    }
+
+    if (predictor != NULL && strcmp(predictor, "3") == 0 && options->output_type != GDT_Float32)
+    {
+        fprintf(stderr, "Floating point predictor needs a Float32 output !\n");
+        return -1;
+    }
+
+    /* GDAL compresses the blocks of a write on a pool of worker threads, the writer only hands them over */
+    if (compressed && CSLFetchNameValue(options->create_options, "NUM_THREADS") == NULL)
+        options->create_options = CSLSetNameValue(options->create_options, "NUM_THREADS", "ALL_CPUS");
+
+    return 0;
+}
+
+/* The library exposes the engine to other programs, which have their own entry point */
+#ifndef LIBRARY_BUILD
+
+/**
+ * @brief Print the program usage.
+ * 
+ * @param program The program name.
+ * 
+ * @return void.
+*/
+void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [options] [input_path] [output_path]\n", program);
+    fprintf(stderr, "       %s bench [options] [bench options] [input_path] [output_path]\n", program);
+    fprintf(stderr, "       %s batch [options] [manifest_path]\n", program);
+    fprintf(stderr, "       %s batch [options] [input_pattern] [output_dir]\n", program);
+    fprintf(stderr, "       %s generate [output options] [generate options] [output_path]\n", program);
+    fprintf(stderr, "       %s serve [options] [serve options] [socket_path]\n", program);
+    fprintf(stderr, "       %s submit [socket_path] JOB [input_path] [output_path] [job options]\n", program);
+    fprintf(stderr, "       %s submit [socket_path] STATUS|SHUTDOWN\n", program);
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  --memory-budget <size>  Cap the strips in flight to <size> (K, M or G suffix, MiB by default).\n");
+    fprintf(stderr, "                          The reader waits when the window is full.\n");
+    fprintf(stderr, "  --kernel <name|path>    Kernel to apply: edge (default), sobel, gaussian5, box7 or a kernel file.\n");
+    fprintf(stderr, "  --simd <isa>            Instruction set of the convolution: auto (default), avx512, avx2, sse4.2 or scalar.\n");
+    fprintf(stderr, "  --output-type <type>    Data type of the output: Byte (default), UInt16, Int16 or Float32.\n");
+    fprintf(stderr, "  --scale <value>         Scale applied to the kernel sums before rounding and saturation (default 1).\n");
+    fprintf(stderr, "  --offset <value>        Offset added to the scaled sums (default 0).\n");
+    fprintf(stderr, "  --parallel-write        Write with one handle per thread (uncompressed output only).\n");
+    fprintf(stderr, "  --interleaved-read      Read every band of a chunk with one call, for pixel interleaved inputs.\n");
+    fprintf(stderr, "  --mapped-read           Filter the input rows in place from a memory mapping of the file (uncompressed\n");
+    fprintf(stderr, "                          band interleaved inputs), falling back to copies otherwise.\n");
+    fprintf(stderr, "  --engine <name>         Filtering engine: strips (default) or tiles, chunks filtered by cache sized tiles.\n");
+    fprintf(stderr, "  --tile-width <columns>  Width of the tiles of the tile engine (sized to the cache by default).\n");
+    fprintf(stderr, "  --chain <steps|path>    Filter chain run in one pass by the tile engine instead of --kernel: kernels and\n");
+    fprintf(stderr, "                          abs, scale:<f>, offset:<v>, threshold:<t>[:<high>], clamp:<lo>:<hi> steps separated\n");
+    fprintf(stderr, "                          by commas, or a file with one step per line.\n");
+    fprintf(stderr, "  --tiled                 Write a tiled output (256x256 tiles by default) instead of strips.\n");
+    fprintf(stderr, "  --block-size <size>     Block size of the output: <width>x<height> for tiles, <height> for strips.\n");
+    fprintf(stderr, "  --compress <method>     Compression of the output: NONE (default), DEFLATE, ZSTD or LZW.\n");
+    fprintf(stderr, "  --predictor <1|2|3>     Predictor of the compression: none, horizontal or floating point.\n");
+    fprintf(stderr, "  --bigtiff <mode>        BigTIFF output: IF_NEEDED (default), IF_SAFER, YES or NO.\n");
+    fprintf(stderr, "  --num-threads <n>       Threads encoding the compressed blocks: a count or ALL_CPUS (default).\n");
+    fprintf(stderr, "  --chunk-rows <n>        Minimum rows of each read and write, rounded up to whole blocks (default 64).\n");
+    fprintf(stderr, "  --grainsize <n>         Rows filtered by each task of the strip engine (default 1).\n");
+    fprintf(stderr, "  --autotune              Choose the chunk rows, grainsize and thread count with calibration passes on a\n");
+    fprintf(stderr, "                          sample of the image, or reuse the ones of the profile for this machine and image.\n");
+    fprintf(stderr, "  --tune-profile <path>   Profile file of the tuned settings (default .lab4_tune).\n");
+    fprintf(stderr, "  --stats                 Print the pipeline statistics at exit: busy, span and idle time of each stage\n");
+    fprintf(stderr, "                          and band, peak strips and hit ratio of the strip lists, lock waits, throughput.\n");
+    fprintf(stderr, "  --stats-json <path>     Write the pipeline statistics as JSON to <path>.\n");
+    fprintf(stderr, "  --counters              Count cycles, instructions, LLC and branch misses of each stage with perf_event_open\n");
+    fprintf(stderr, "                          and print the IPC and the misses per pixel at exit (Linux only).\n");
+    fprintf(stderr, "  --trace <path>          Write a timeline of every read, filter and write and of the lock waits, by thread\n");
+    fprintf(stderr, "                          and band, as Chrome trace JSON to <path> (chrome://tracing or ui.perfetto.dev).\n");
+    fprintf(stderr, "\nBench options:\n");
+    fprintf(stderr, "  --iterations <n>        Timed runs for each thread count (default 5).\n");
+    fprintf(stderr, "  --warmup <n>            Untimed runs before the timed ones (default 1).\n");
+    fprintf(stderr, "  --threads <list>        Thread counts to sweep, separated by commas, e.g. 1,2,4,8 (default OMP_NUM_THREADS).\n");
+    fprintf(stderr, "  --json <path>           Write the results as JSON to <path>.\n");
+    fprintf(stderr, "\nGenerate options (with --output-type and the output layout options):\n");
+    fprintf(stderr, "  --size <width>x<height> Size of the raster (default 1024x1024).\n");
+    fprintf(stderr, "  --bands <n>             Number of bands (default 3).\n");
+    fprintf(stderr, "  --seed <n>              Seed of the noise, the same seed gives the same pixels (default 0).\n");
+    fprintf(stderr, "\nServe options:\n");
+    fprintf(stderr, "  --queue-depth <n>       Jobs waiting to run before new ones are rejected with BUSY (default %d).\n", SERVER_QUEUE_DEPTH);
+    fprintf(stderr, "\nJob options (the options of the server apply to the others):\n");
+    fprintf(stderr, "  --kernel, --chain, --engine, --output-type, --scale and --offset, as above.\n");
+}
+
+int main(int argc, char* argv[])
+{
+    process_options options = { .memory_budget = 0, .output_type = GDT_Byte, .scale = 1, .offset = 0, .parallel_write = 0, .interleaved_read = 0, .mapped_read = 0, .create_options = NULL, .engine = ENGINE_STRIPS, .tile_width = 0, .chain = NULL };
+    const char* kernel_name = "edge";
+    const char* chain_steps = NULL;
+    int engine_set = 0;
+    bench_options bench_opts = { .iterations = 5, .warmup = 1, .threads = NULL, .threads_count = 0, .json_path = NULL, .filter = NULL };
+    generate_options generate_opts = { .x_size = 1024, .y_size = 1024, .bands = 3, .type = GDT_Byte, .seed = 0 };
+    int bench_mode = argc > 1 && strcmp(argv[1], "bench") == 0;
+    int generate_mode = argc > 1 && strcmp(argv[1], "generate") == 0;
+    int batch_mode = argc > 1 && strcmp(argv[1], "batch") == 0;
+    int serve_mode = argc > 1 && strcmp(argv[1], "serve") == 0;
+    int queue_depth = SERVER_QUEUE_DEPTH;
+    int serve_set = 0;
+    int bench_set = 0;
+    int generate_set = 0;
+    int print_stats = 0;
+    const char* stats_json = NULL;
+    const char* trace_path = NULL;
+    int hardware_counters = 0;
+    int autotune = 0;
+    const char* tune_profile = TUNE_PROFILE_PATH;
+    int chunk_min_rows = 0;
+    int grainsize = 0;
+    int tune_set = 0;
+    const char* isa = NULL;
+    const char* choice;
+    int block_x_size, block_y_size;
+    int seed;
+
+    const char* const engines[] = { "strips", "tiles", NULL };
+    const char* const compressions[] = { "NONE", "DEFLATE", "ZSTD", "LZW", NULL };
+    const char* const predictors[] = { "1", "2", "3", NULL };
+    const char* const bigtiff_modes[] = { "IF_NEEDED", "IF_SAFER", "YES", "NO", NULL };
+
+    const struct option long_options[] =
+    {
+        { "memory-budget",    required_argument, NULL, 'm' },
+        { "kernel",           required_argument, NULL, 'k' },
+        { "simd",             required_argument, NULL, 's' },
+        { "output-type",      required_argument, NULL, 't' },
+        { "scale",            required_argument, NULL, 'c' },
+        { "offset",           required_argument, NULL, 'o' },
+        { "parallel-write",   no_argument,       NULL, 'w' },
+        { "interleaved-read", no_argument,       NULL, 'i' },
+        { "mapped-read",      no_argument,       NULL, 'p' },
+        { "engine",           required_argument, NULL, 'e' },
+        { "tile-width",       required_argument, NULL, 'x' },
+        { "chain",            required_argument, NULL, 'l' },
+        { "tiled",            no_argument,       NULL, 'T' },
+        { "block-size",       required_argument, NULL, 'B' },
+        { "compress",         required_argument, NULL, 'C' },
+        { "predictor",        required_argument, NULL, 'P' },
+        { "bigtiff",          required_argument, NULL, 'G' },
+        { "num-threads",      required_argument, NULL, 'N' },
+        { "stats",            no_argument,       NULL, 'A' },
+        { "stats-json",       required_argument, NULL, 'j' },
+        { "trace",            required_argument, NULL, 'R' },
+        { "counters",         no_argument,       NULL, 'H' },
+        { "chunk-rows",       required_argument, NULL, 'r' },
+        { "grainsize",        required_argument, NULL, 'g' },
+        { "autotune",         no_argument,       NULL, 'a' },
+        { "tune-profile",     required_argument, NULL, 'f' },
+        { "iterations",       required_argument, NULL, 'I' },
+        { "warmup",           required_argument, NULL, 'W' },
+        { "threads",          required_argument, NULL, 'n' },
+        { "json",             required_argument, NULL, 'J' },
+        { "size",             required_argument, NULL, 'S' },
+        { "bands",            required_argument, NULL, 'b' },
+        { "seed",             required_argument, NULL, 'd' },
+        { "queue-depth",      required_argument, NULL, 'q' },
+        { "help",             no_argument,       NULL, 'h' },
+        { NULL,               0,                 NULL,  0  }
+    };
+
+    int opt;
+
+    /* The client only forwards its arguments, the server parses them */
+    if (argc > 1 && strcmp(argv[1], "submit") == 0)
+        return (submit(argc - 2, argv + 2) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    /* The subcommands take the same options, their own ones and the files after them */
+    if (bench_mode || generate_mode || batch_mode || serve_mode)
+        optind = 2;
+
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'm':
+                if (parse_memory_size(optarg, &options.memory_budget) != 0)
+                {
+                    fprintf(stderr, "Invalid memory budget: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'k':
+                kernel_name = optarg;
+                break;
+
+            case 's':
+                isa = optarg;
+                break;
+
+            case 't':
+                if (parse_output_type(optarg, &options.output_type) != 0)
+                {
+                    fprintf(stderr, "Invalid output type: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'c':
+                if (parse_float(optarg, &options.scale) != 0)
+                {
+                    fprintf(stderr, "Invalid scale: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'o':
+                if (parse_float(optarg, &options.offset) != 0)
+                {
+                    fprintf(stderr, "Invalid offset: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'w':
+                options.parallel_write = 1;
+                break;
+
+            case 'i':
+                options.interleaved_read = 1;
+                break;
+
+            case 'p':
+                options.mapped_read = 1;
+                break;
+
+            case 'e':
+                if ((choice = parse_choice(optarg, engines)) == NULL)
+                {
+                    fprintf(stderr, "Invalid engine: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                options.engine = (choice == engines[1]) ? ENGINE_TILES : ENGINE_STRIPS;
+                engine_set = 1;
+                break;
+
+            case 'x':
+                if ((options.tile_width = atoi(optarg)) < 1 || strspn(optarg, "0123456789") != strlen(optarg))
+                {
+                    fprintf(stderr, "Invalid tile width: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'l':
+                chain_steps = optarg;
+                break;
+
+            case 'T':
+                options.create_options = CSLSetNameValue(options.create_options, "TILED", "YES");
+                break;
+
+            case 'B':
+                if (parse_block_size(optarg, &block_x_size, &block_y_size) != 0)
+                {
+                    fprintf(stderr, "Invalid block size: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                if (block_x_size)
+                    options.create_options = CSLSetNameValue(options.create_options, "BLOCKXSIZE", CPLSPrintf("%d", block_x_size));
+
+                options.create_options = CSLSetNameValue(options.create_options, "BLOCKYSIZE", CPLSPrintf("%d", block_y_size));
+                break;
+
+            case 'C':
+                if ((choice = parse_choice(optarg, compressions)) == NULL)
+                {
+                    fprintf(stderr, "Invalid compression: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                options.create_options = CSLSetNameValue(options.create_options, "COMPRESS", choice);
+                break;
+
+            case 'P':
+                if ((choice = parse_choice(optarg, predictors)) == NULL)
+                {
+                    fprintf(stderr, "Invalid predictor: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                options.create_options = CSLSetNameValue(options.create_options, "PREDICTOR", choice);
+                break;
+
+            case 'G':
+                if ((choice = parse_choice(optarg, bigtiff_modes)) == NULL)
+                {
+                    fprintf(stderr, "Invalid BigTIFF mode: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                options.create_options = CSLSetNameValue(options.create_options, "BIGTIFF", choice);
+                break;
+
+            case 'N':
+                if (strcasecmp(optarg, "ALL_CPUS") != 0 && (atoi(optarg) < 1 || strspn(optarg, "0123456789") != strlen(optarg)))
+                {
+                    fprintf(stderr, "Invalid number of threads: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                options.create_options = CSLSetNameValue(options.create_options, "NUM_THREADS", optarg);
+                break;
+
+            case 'I':
+                if (parse_count(optarg, &bench_opts.iterations, 1) != 0)
+                {
+                    fprintf(stderr, "Invalid number of iterations: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                bench_set = 1;
+                break;
+
+            case 'W':
+                if (parse_count(optarg, &bench_opts.warmup, 0) != 0)
+                {
+                    fprintf(stderr, "Invalid number of warmup runs: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                bench_set = 1;
+                break;
+
+            case 'n':
+                free(bench_opts.threads);
+
+                if (parse_threads(optarg, &bench_opts.threads, &bench_opts.threads_count) != 0)
+                {
+                    fprintf(stderr, "Invalid thread counts: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                bench_set = 1;
+                break;
+
+            case 'J':
+                bench_opts.json_path = optarg;
+                bench_set = 1;
+                break;
+
+            case 'A':
+                print_stats = 1;
+                break;
+
+            case 'j':
+                stats_json = optarg;
+                break;
+
+            case 'R':
+                trace_path = optarg;
+                break;
+
+            case 'H':
+                hardware_counters = 1;
+                break;
+
+            case 'r':
+                if (parse_count(optarg, &chunk_min_rows, 1) != 0)
+                {
+                    fprintf(stderr, "Invalid chunk rows: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                tune_set = 1;
+                break;
+
+            case 'g':
+                if (parse_count(optarg, &grainsize, 1) != 0)
+                {
+                    fprintf(stderr, "Invalid grainsize: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                tune_set = 1;
+                break;
+
+            case 'a':
+                autotune = 1;
+                tune_set = 1;
+                break;
+
+            case 'f':
+                tune_profile = optarg;
+                tune_set = 1;
+                break;
+
+            case 'S':
+                if (parse_block_size(optarg, &generate_opts.x_size, &generate_opts.y_size) != 0 || generate_opts.x_size == 0)
+                {
+                    fprintf(stderr, "Invalid size: %s, it must be <width>x<height> !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                generate_set = 1;
+                break;
+
+            case 'b':
+                if (parse_count(optarg, &generate_opts.bands, 1) != 0)
+                {
+                    fprintf(stderr, "Invalid number of bands: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                generate_set = 1;
+                break;
+
+            case 'd':
+                if (parse_count(optarg, &seed, 0) != 0)
+                {
+                    fprintf(stderr, "Invalid seed: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                generate_opts.seed = (uint32_t)seed;
+                generate_set = 1;
+                break;
+
+            case 'q':
+                if (parse_count(optarg, &queue_depth, 1) != 0)
+                {
+                    fprintf(stderr, "Invalid queue depth: %s !\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                serve_set = 1;
+                break;
+
+            case 'h':
+                usage(argv[0]);
+                return EXIT_SUCCESS;
+
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (generate_mode && argc - optind != 1)
+    {
+        fprintf(stderr, "Invalid number of arguments: [output_path] !\n");
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (batch_mode && argc - optind != 1 && argc - optind != 2)
+    {
+        fprintf(stderr, "Invalid number of arguments: [manifest_path] or [input_pattern] [output_dir] !\n");
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (serve_mode && argc - optind != 1)
+    {
+        fprintf(stderr, "Invalid number of arguments: [socket_path] !\n");
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!generate_mode && !batch_mode && !serve_mode && argc - optind != 2)
+    {
+        fprintf(stderr, "Invalid number of arguments: [input_path] [output_path] !\n");
+        usage(argv[0]);
+        return EXIT_FAILURE; 
+    }
+
+    if (bench_set && !bench_mode)
+    {
+        fprintf(stderr, "Bench options need the bench subcommand !\n");
+        return EXIT_FAILURE;
+    }
+
+    if (generate_set && !generate_mode)
+    {
+        fprintf(stderr, "Generate options need the generate subcommand !\n");
+        return EXIT_FAILURE;
+    }
+
+    if (serve_set && !serve_mode)
+    {
+        fprintf(stderr, "Serve options need the serve subcommand !\n");
+        return EXIT_FAILURE;
+    }
+
+    if (tune_set && generate_mode)
+    {
+        fprintf(stderr, "Tuning options do not apply to the generate subcommand !\n");
+        return EXIT_FAILURE;
+    }
+
+    /* The server has no input to calibrate on before its first job */
+    if (autotune && serve_mode)
+    {
+        fprintf(stderr, "--autotune does not apply to the serve subcommand, use --chunk-rows and --grainsize !\n");
+        return EXIT_FAILURE;
+    }
+
+    /* The bench reports its own stage times for each run */
+    if ((print_stats || stats_json || trace_path || hardware_counters) && (bench_mode || generate_mode || serve_mode))
+    {
+        fprintf(stderr, "Statistics options do not apply to the subcommands !\n");
+        return EXIT_FAILURE;
+    }
+
+    if (check_create_options(&options) != 0)
+        return EXIT_FAILURE;
+
+    const char* input_path = (generate_mode || serve_mode) ? NULL : argv[optind];
+    const char* output_path = argv[argc - 1];
+    batch* jobs = NULL;
+
+    if (batch_mode)
+    {
+        jobs = (argc - optind == 1) ? batch_load_manifest(argv[optind]) : batch_load_glob(argv[optind], argv[optind + 1]);
+
+        if (jobs == NULL)
+            return EXIT_FAILURE;
+
+        /* The first file stands for the batch when tuning */
+        input_path = jobs->inputs[0];
+    }
+
+    generate_opts.type = options.output_type;
+
+    GDALAllRegister();
+
+    if (convolve_init(isa) != 0)
+        return EXIT_FAILURE;
+
+    fprintf(stdout, "\nUsing %s convolution !\n", convolve_get_isa());
+
+    kernel* kern = kernel_load(kernel_name);
+
+    if (kern == NULL)
+    {
+        fprintf(stderr, "Failed on load kernel %s !\n", kernel_name);
+        return EXIT_FAILURE;
+    }
+
+    chain* ch = NULL;
+
+    if (chain_steps)
+    {
+        if ((ch = chain_load(chain_steps)) == NULL)
+        {
+            fprintf(stderr, "Failed on load chain %s !\n", chain_steps);
+            return EXIT_FAILURE;
+        }
+
+        /* The stages of a chain are fused on the tiles, the strip engine only applies one kernel */
+        if (engine_set && options.engine != ENGINE_TILES)
+            fprintf(stderr, "Filter chains run on the tile engine !\n");
+
+        options.chain = ch;
+        options.engine = ENGINE_TILES;
+    }
+
+    int rank = 0;
+
+    #ifdef MPI_PROCESSING
+        /* Only the main thread of each rank calls MPI, between the parallel regions */
+        int provided;
+
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    #endif
+
+    if (autotune && tune(input_path, kern, &options, tune_profile) != 0)
+    {
+        #ifdef MPI_PROCESSING
+            MPI_Finalize();
+        #endif
+
+        return EXIT_FAILURE;
+    }
+
+    /* Explicit settings take precedence over the tuned ones */
+    if (chunk_min_rows)
+        set_chunk_min_rows(chunk_min_rows);
+
+    if (grainsize)
+        set_filter_grainsize(grainsize);
+
+    int status = EXIT_SUCCESS;
+
+    if (generate_mode)
+    {
+        /* The raster is written by one process, the other ranks have nothing to do */
+        if (rank == 0)
+        {
+            fprintf(stdout, "\nGenerating %dx%d raster of %d %s bands !\n", generate_opts.x_size, generate_opts.y_size, generate_opts.bands, GDALGetDataTypeName(generate_opts.type));
+
+            double time = generate_file(output_path, &generate_opts, options.create_options);
+
+            if (time < 0)
+                status = EXIT_FAILURE;
+            else
+                fprintf(stdout, "\nTotal time: %f\n", time);
+        }
+    }
+    else if (serve_mode)
+    {
+        fprintf(stdout, "\nStarting server !\n");
+
+        if (serve(argv[optind], kern, &options, queue_depth) != 0)
+            status = EXIT_FAILURE;
+
+        fprintf(stdout, "\nEnding server !\n");
+    }
+    else if (!bench_mode)
+    {
+        double time;
+
+        stats_reset();
+
+        if (trace_path)
+            trace_start();
+
+        if (hardware_counters)
+            counters_enable();
+
+        if (batch_mode)
+        {
+            int failures;
+
+            fprintf(stdout, "\nStarting batch of %d files !\n", jobs->count);
+
+            time = batch_process(jobs, kern, &options, &failures);
+
+            if (failures > 0)
+                status = EXIT_FAILURE;
+
+            fprintf(stdout, "\nEnding batch !\n");
+        }
+        else
+        {
+            fprintf(stdout, "\nStarting process !\n");
+
+            if ((time = process_file(input_path, output_path, kern, &options)) < 0)
+                status = EXIT_FAILURE;
+
+            fprintf(stdout, "\nEnding process !\n");
+        }
+
+        fprintf(stdout, "\nTotal time: %f\n", time);
+
+        if (print_stats)
+            stats_print(stdout, time);
+
+        if (hardware_counters)
+            counters_print(stdout, stats_get_pixels());
+
+        if (stats_json && stats_write_json(stats_json, time) != 0)
+            status = EXIT_FAILURE;
+
+        if (trace_path && trace_write(trace_path) != 0)
+            status = EXIT_FAILURE;
+    }
+    else
+    {
+        fprintf(stdout, "\nStarting bench !\n");
+
+        bench_opts.filter = chain_steps ? chain_steps : kernel_name;
+
+        if (bench(input_path, output_path, kern, &options, &bench_opts) != 0)
+            status = EXIT_FAILURE;
+
+        fprintf(stdout, "\nEnding bench !\n");
+    }
+
+    #ifdef MPI_PROCESSING
+        MPI_Finalize();
+    #endif
+
+    kernel_free(kern);
+    chain_free(ch);
+    batch_free(jobs);
+
+    CSLDestroy(options.create_options);
+
+    free(bench_opts.threads);
+
+    return status;
 }
 
+#endif // LIBRARY_BUILD
@@ -1,327 +1,743 @@
 #include "processes.h"
 
+/* Minimum rows of the chunks and rows of the filter tasks, set for the whole process like the convolution */
+static int chunk_min_rows = IO_CHUNK_MIN_ROWS;
+static int filter_grainsize = 1;
+
+/**
+ * @brief Clamp a column or row index to the image, replicating the edge pixels.
+ * 
+ * @param index The index to clamp.
+ * @param size The number of columns or rows.
+ * 
+ * @return int The clamped index.
+*/
+static inline int clamp_index(int index, int size)
+{
+    return (index < 0) ? 0 : ((index >= size) ? size - 1 : index);
+}
+
+void apply_kern(const float* const* rows, float* output_strip, const kernel* kern, int strip_width, float* scratch)
+{
+    if (kern->separable)
+    {
+        /* Vertical pass with the column vector, then horizontal pass with the row vector: 2 * size taps per pixel */
+        convolve(rows, kern->column, kern->size, 1, scratch, strip_width);
+        convolve((const float* const*) &scratch, kern->row, 1, kern->size, output_strip, strip_width);
+    }
+    else
+        convolve(rows, kern->weights, kern->size, kern->size, output_strip, strip_width);
+}
+
+/**
+ * @brief Get the number of filtered strips that use a given input strip.
+ * 
+ * @param index The index of the input strip.
+ * @param slab_first The first strip filtered.
+ * @param slab_last The strip after the last one filtered.
+ * @param radius The number of halo strips on each side of a filtered strip.
+ * 
+ * @return int The number of uses of the strip.
+*/
+int get_strip_uses(int index, int slab_first, int slab_last, int radius)
+{
+    int first = (index - radius > slab_first) ? index - radius : slab_first;
+    int last = (index + radius < slab_last - 1) ? index + radius : slab_last - 1;
+
+    return last - first + 1;
+}
+
+GDALDataType get_strip_type(GDALRasterBandH band)
+{
+    GDALDataType type = GDALGetRasterDataType(band);
+
+    return (type == GDT_Byte || type == GDT_UInt16 || type == GDT_Int16) ? type : GDT_Float32;
+}
+
+GDALDataType get_sum_type(const kernel* kern, GDALDataType type)
+{
+    /* Separable kernels larger than 3x3 take fewer float taps than integer ones */
+    if (type != GDT_Float32 && kern->integers != NULL && (!kern->separable || kern->size <= 3))
+        return GDT_Int32;
+
+    return GDT_Float32;
+}
+
+GDALDataType get_kernel_strip_type(const kernel* kern, GDALRasterBandH band)
+{
+    GDALDataType type = get_strip_type(band);
+
+    /* Float sums need float rows: GDAL converts each row once when it is read, where the filter would
+       convert it again for every output row it is a tap of */
+    return (get_sum_type(kern, type) == GDT_Float32) ? GDT_Float32 : type;
+}
+
+void set_chunk_min_rows(int rows)
+{
+    chunk_min_rows = (rows > 0) ? rows : IO_CHUNK_MIN_ROWS;
+}
+
+int get_chunk_min_rows(void)
+{
+    return chunk_min_rows;
+}
+
+void set_filter_grainsize(int grainsize)
+{
+    filter_grainsize = (grainsize > 0) ? grainsize : 1;
+}
+
+int get_filter_grainsize(void)
+{
+    return filter_grainsize;
+}
+
+int get_chunk_rows(GDALRasterBandH band, int y_size)
+{
+    int block_x_size;
+    int block_y_size;
+
+    GDALGetBlockSize(band, &block_x_size, &block_y_size);
+
+    if (block_y_size < 1)
+        block_y_size = 1;
+
+    int chunk_rows = ((chunk_min_rows + block_y_size - 1) / block_y_size) * block_y_size;
+
+    return (chunk_rows > y_size) ? y_size : chunk_rows;
+}
+
 #ifdef PARALLEL_PROCESSING
-    /**
-     * @brief applies the kernel to a given strip.
-     * 
-     * @param prev_strip The previous strip.
-     * @param curr_strip The current strip on aplly kern.
-     * @param next_strip The next strip.
-     * @param output_strip The output strip to save result.
-     * @param lineal_kern The kernel to apply.
-     * @param strip_width The width of the strip.
-     * 
-     * @return void.
-    */
-    void apply_kern(float* prev_strip, float* curr_strip, float* next_strip, float* output_strip, const float kern[9], int strip_width)
+    int read_tiff(strip_list* buffer, dataset_pool* pool, int x_size, int y_size, int band_index, GDALDataType type, int first_row, int last_row, int radius, int slab_first, int slab_last)
     {
-        int prev_col_index;
-        int curr_col_index;
-        int next_col_index;
+        int count = 0;
+        int status = 0;
+        size_t row_bytes = (size_t)GDALGetDataTypeSizeBytes(type) * (size_t)x_size;
+        char* chunk;
+        int chunk_rows;
+        int rows;
+
+        GDALRasterBandH band = GDALGetRasterBand(dataset_pool_acquire(pool), band_index);
+
+        chunk_rows = (band != NULL) ? get_chunk_rows(band, y_size) : 0;
 
-        #pragma omp taskloop simd private(curr_col_index, prev_col_index, next_col_index) shared(output_strip, prev_strip, curr_strip, next_strip, kern)
-        for (int x = 0; x < strip_width; x++)
+        dataset_pool_release(pool);
+
+        if(band == NULL)
         {
-            prev_col_index = (x - 1 < 0) ? x : (x - 1);
-            curr_col_index = x;
-            next_col_index = (x + 1 == strip_width) ? x : (x + 1);
-
-            output_strip[curr_col_index] = kern[0] * prev_strip[prev_col_index] +
-                                           kern[1] * curr_strip[prev_col_index] +
-                                           kern[2] * next_strip[prev_col_index] +
-                                           kern[3] * prev_strip[curr_col_index] +
-                                           kern[4] * curr_strip[curr_col_index] +
-                                           kern[5] * next_strip[curr_col_index] +
-                                           kern[6] * prev_strip[next_col_index] +
-                                           kern[7] * curr_strip[next_col_index] +
-                                           kern[8] * next_strip[next_col_index];
+            fprintf(stderr, "Failed on get band %d !\n", band_index);
+            return -1;
         }
-    }
-#else
-    /**
-     * @brief applies the kernel to a given strip.
-     * 
-     * @param prev_strip The previous strip.
-     * @param curr_strip The current strip on aplly kern.
-     * @param next_strip The next strip.
-     * @param output_strip The output strip to save result.
-     * @param lineal_kern The kernel to apply.
-     * @param strip_width The width of the strip.
-     * 
-     * @return void.
-    */
-    void apply_kern(float* prev_strip, float* curr_strip, float* next_strip, float* output_strip, const float kern[9], int strip_width)
-    {
-        int prev_col_index = 0;
-        int curr_col_index;
-        int next_col_index = 1;
 
-        for (int x = 0; x < strip_width; x++)
+        #pragma omp taskloop grainsize(1) private(band, chunk, rows) shared(buffer, pool, band_index, type, row_bytes, first_row, last_row, x_size, y_size, radius, slab_first, slab_last, chunk_rows, count, status)
+        for(int i = first_row; i < last_row; i += chunk_rows)
         {
-            curr_col_index = x;
-
-            output_strip[curr_col_index] = kern[0] * prev_strip[prev_col_index] +
-                                           kern[1] * curr_strip[prev_col_index] +
-                                           kern[2] * next_strip[prev_col_index] +
-                                           kern[3] * prev_strip[curr_col_index] +
-                                           kern[4] * curr_strip[curr_col_index] +
-                                           kern[5] * next_strip[curr_col_index] +
-                                           kern[6] * prev_strip[next_col_index] +
-                                           kern[7] * curr_strip[next_col_index] +
-                                           kern[8] * next_strip[next_col_index];
-
-            prev_col_index = curr_col_index;
-            next_col_index = (curr_col_index + 2 < strip_width) ? curr_col_index + 1 : curr_col_index;
+            double start_time = stats_start();
+
+            rows = (i + chunk_rows > last_row) ? (last_row - i) : chunk_rows;
+
+            chunk = strip_alloc(x_size * rows, type);
+
+            #pragma omp atomic
+            count += rows;
+
+            band = GDALGetRasterBand(dataset_pool_acquire(pool), band_index);
+
+            if (GDALRasterIO(band, GF_Read, 0, i, x_size, rows, chunk, x_size, rows, type, 0, 0) != CE_None)
+            {
+                fprintf(stderr, "Thread %d -> Failed read band %d lines %d-%d (count: %d) !\n", omp_get_thread_num(), band_index, i, i + rows - 1, count);
+
+                #pragma omp atomic write
+                status = -1;
+            }
+            #ifdef READ_PRINTS
+            else
+                fprintf(stdout, "Thread %d -> Read band %d lines %d-%d (count: %d) !\n", omp_get_thread_num(), band_index, i, i + rows - 1, count);
+            #endif
+
+            dataset_pool_release(pool);
+
+            for (int j = 0; j < rows; j++)
+            {
+                strip input_strip = strip_alloc(x_size, type);
+
+                memcpy(input_strip, chunk + (size_t)j * row_bytes, row_bytes);
+
+                if (strip_list_add_shared(buffer, i + j, input_strip, get_strip_uses(i + j, slab_first, slab_last, radius)) != 0)
+                {
+                    CPLFree(input_strip);
+
+                    #pragma omp atomic write
+                    status = -1;
+                }
+            }
+
+            CPLFree(chunk);
+
+            stats_add(STAGE_READ, band_index, start_time);
         }
+
+        if (last_row == y_size)
+            fprintf(stdout, "\nBand %d READ end !\n", band_index);
+
+        return status;
     }
-#endif
 
-#ifdef PARALLEL_PROCESSING
-    void read_tiff(strip_list* buffer, GDALDatasetH dataset, omp_lock_t* dataset_mutex, int x_size, int y_size, int band_index)
+    int read_tiff_bands(strip_list** buffers, dataset_pool* pool, int x_size, int y_size, int bands, GDALDataType type, int first_row, int last_row, int radius, int slab_first, int slab_last)
     {
         int count = 0;
-        strip input_strip;
+        int status = 0;
+        size_t row_bytes = (size_t)GDALGetDataTypeSizeBytes(type) * (size_t)x_size;
+        GDALDatasetH dataset;
+        char* chunk;
+        int chunk_rows;
+        int rows;
 
-        GDALRasterBandH band = GDALGetRasterBand(dataset, band_index);
+        GDALRasterBandH band = GDALGetRasterBand(dataset_pool_acquire(pool), 1);
+
+        chunk_rows = (band != NULL) ? get_chunk_rows(band, y_size) : 0;
+
+        dataset_pool_release(pool);
 
         if(band == NULL)
         {
-            fprintf(stderr, "Failed on get band %d !\n", band_index);
-            return;
+            fprintf(stderr, "Failed on get band 1 !\n");
+            return -1;
         }
 
-        #pragma omp taskloop grainsize(1) private(input_strip) shared(buffer, dataset_mutex, band_index, y_size, x_size, count)
-        for(int i = 0; i < y_size; i++)
+        #pragma omp taskloop grainsize(1) private(dataset, chunk, rows) shared(buffers, pool, bands, type, row_bytes, first_row, last_row, x_size, y_size, radius, slab_first, slab_last, chunk_rows, count, status)
+        for(int i = first_row; i < last_row; i += chunk_rows)
         {
-            input_strip = strip_alloc(x_size);
+            double start_time = stats_start();
+
+            rows = (i + chunk_rows > last_row) ? (last_row - i) : chunk_rows;
+
+            /* The chunk holds the rows of band 1, then the rows of band 2 and so on */
+            chunk = strip_alloc(x_size * rows * bands, type);
 
             #pragma omp atomic
-            count++;
+            count += rows;
+
+            dataset = dataset_pool_acquire(pool);
 
-            omp_set_lock(dataset_mutex);
+            if (GDALDatasetRasterIO(dataset, GF_Read, 0, i, x_size, rows, chunk, x_size, rows, type, bands, NULL, 0, 0, 0) != CE_None)
+            {
+                fprintf(stderr, "Thread %d -> Failed read bands lines %d-%d (count: %d) !\n", omp_get_thread_num(), i, i + rows - 1, count);
 
-            if (GDALRasterIO(band, GF_Read, 0, i, x_size, 1, input_strip, x_size, 1, GDT_Float32, 0, 0) != CE_None)
-                fprintf(stderr, "Thread %d -> Failed read band %d line %d (count: %d) !\n", omp_get_thread_num(), band_index, i, count);
+                #pragma omp atomic write
+                status = -1;
+            }
             #ifdef READ_PRINTS
             else
-                fprintf(stdout, "Thread %d -> Read band %d line %d (count: %d) !\n", omp_get_thread_num(), band_index, i, count);
+                fprintf(stdout, "Thread %d -> Read bands lines %d-%d (count: %d) !\n", omp_get_thread_num(), i, i + rows - 1, count);
             #endif
 
-            omp_unset_lock(dataset_mutex);
+            dataset_pool_release(pool);
 
-            strip_list_add(buffer, i, input_strip);
+            for (int b = 0; b < bands; b++)
+            {
+                for (int j = 0; j < rows; j++)
+                {
+                    strip input_strip = strip_alloc(x_size, type);
+
+                    memcpy(input_strip, chunk + ((size_t)b * (size_t)rows + (size_t)j) * row_bytes, row_bytes);
+
+                    if (strip_list_add_shared(buffers[b], i + j, input_strip, get_strip_uses(i + j, slab_first, slab_last, radius)) != 0)
+                    {
+                        CPLFree(input_strip);
+
+                        #pragma omp atomic write
+                        status = -1;
+                    }
+                }
+            }
+
+            CPLFree(chunk);
+
+            stats_add(STAGE_READ, 0, start_time);
         }
 
-        fprintf(stdout, "\nBand %d READ end !\n", band_index);
+        if (last_row == y_size)
+            fprintf(stdout, "\nBands READ end !\n");
+
+        return status;
     }
 #else
-    void read_tiff(strip_list* buffer, GDALDatasetH dataset, int x_size, int y_size, int band_index)
+    int read_tiff(strip_list* buffer, GDALDatasetH dataset, int x_size, int y_size, int band_index, GDALDataType type, int first_row, int last_row, int radius, int slab_first, int slab_last)
     {
         int count = 0;
-        strip input_strip;
+        int status = 0;
+        size_t row_bytes = (size_t)GDALGetDataTypeSizeBytes(type) * (size_t)x_size;
+        char* chunk;
+        int chunk_rows;
+        int rows;
     
         GDALRasterBandH band = GDALGetRasterBand(dataset, band_index);
     
         if(band == NULL)
         {
             fprintf(stderr, "Failed on get band %d !\n", band_index);
-            return;
+            return -1;
         }
+
+        chunk_rows = get_chunk_rows(band, y_size);
+
+        chunk = strip_alloc(x_size * chunk_rows, type);
         
-        for(int i = 0; i < y_size; i++)
+        for(int i = first_row; i < last_row; i += chunk_rows)
         {
-            input_strip = strip_alloc(x_size);
+            double start_time = stats_start();
+
+            rows = (i + chunk_rows > last_row) ? (last_row - i) : chunk_rows;
     
-            count++;
+            count += rows;
     
-            if (GDALRasterIO(band, GF_Read, 0, i, x_size, 1, input_strip, x_size, 1, GDT_Float32, 0, 0) != CE_None)
-                fprintf(stderr, "Failed read band %d line %d (count: %d) !\n", band_index, i, count);
+            if (GDALRasterIO(band, GF_Read, 0, i, x_size, rows, chunk, x_size, rows, type, 0, 0) != CE_None)
+            {
+                fprintf(stderr, "Failed read band %d lines %d-%d (count: %d) !\n", band_index, i, i + rows - 1, count);
+                status = -1;
+            }
             #ifdef READ_PRINTS
             else
-                fprintf(stdout, "Read band %d line %d (count: %d) !\n", band_index, i, count);
+                fprintf(stdout, "Read band %d lines %d-%d (count: %d) !\n", band_index, i, i + rows - 1, count);
             #endif
 
-            strip_list_add(buffer, i, input_strip);
+            for (int j = 0; j < rows; j++)
+            {
+                strip input_strip = strip_alloc(x_size, type);
+
+                memcpy(input_strip, chunk + (size_t)j * row_bytes, row_bytes);
+
+                if (strip_list_add_shared(buffer, i + j, input_strip, get_strip_uses(i + j, slab_first, slab_last, radius)) != 0)
+                {
+                    CPLFree(input_strip);
+                    status = -1;
+                }
+            }
+
+            stats_add(STAGE_READ, band_index, start_time);
         }
+
+        CPLFree(chunk);
     
-        fprintf(stdout, "\nBand %d READ end !\n", band_index);
+        if (last_row == y_size)
+            fprintf(stdout, "\nBand %d READ end !\n", band_index);
+
+        return status;
     }
-#endif
 
-#ifdef PARALLEL_PROCESSING
-    void filter_tiff(strip_list* read_buffer, strip_list* write_buffer, int x_size, int y_size, int band_index, const int kern[3][3])
+    int read_tiff_bands(strip_list** buffers, GDALDatasetH dataset, int x_size, int y_size, int bands, GDALDataType type, int first_row, int last_row, int radius, int slab_first, int slab_last)
     {
-        const float lineal_kern[9] =
-        {
-            (float)kern[0][0], (float)kern[1][0], (float)kern[2][0],
-            (float)kern[0][1], (float)kern[1][1], (float)kern[2][1],
-            (float)kern[0][2], (float)kern[1][2], (float)kern[2][2]
-        };
+        int count = 0;
+        int status = 0;
+        size_t row_bytes = (size_t)GDALGetDataTypeSizeBytes(type) * (size_t)x_size;
+        char* chunk;
+        int chunk_rows;
+        int rows;
 
-        int prev_strip_index;
-        int curr_strip_index;
-        int next_strip_index;
+        GDALRasterBandH band = GDALGetRasterBand(dataset, 1);
 
-        strip prev_strip = NULL;
-        strip curr_strip = NULL;
-        strip next_strip = NULL;
+        if(band == NULL)
+        {
+            fprintf(stderr, "Failed on get band 1 !\n");
+            return -1;
+        }
 
-        strip output_strip;
+        chunk_rows = get_chunk_rows(band, y_size);
 
-        int count = 0;
+        /* The chunk holds the rows of band 1, then the rows of band 2 and so on */
+        chunk = strip_alloc(x_size * chunk_rows * bands, type);
 
-        #pragma omp taskloop grainsize(1) private(prev_strip_index, curr_strip_index, next_strip_index, prev_strip, curr_strip, next_strip, output_strip) shared(read_buffer, write_buffer, x_size, y_size, lineal_kern, count)
-        for(int i = 0; i < y_size; i++)
+        for(int i = first_row; i < last_row; i += chunk_rows)
         {
-            prev_strip_index = (i - 1 < 0) ? 0 : (i - 1);
-            curr_strip_index = i;
-            next_strip_index = (i + 1 == y_size) ? i : (i + 1);
+            double start_time = stats_start();
 
-            while (!(curr_strip = strip_list_get(read_buffer, curr_strip_index)));
-            while (!(prev_strip = strip_list_get(read_buffer, prev_strip_index)));
-            while (!(next_strip = strip_list_get(read_buffer, next_strip_index)));
+            rows = (i + chunk_rows > last_row) ? (last_row - i) : chunk_rows;
 
-            output_strip = strip_alloc(x_size);
+            count += rows;
 
-            apply_kern(prev_strip, curr_strip, next_strip, output_strip, lineal_kern, x_size);
+            if (GDALDatasetRasterIO(dataset, GF_Read, 0, i, x_size, rows, chunk, x_size, rows, type, bands, NULL, 0, 0, 0) != CE_None)
+            {
+                fprintf(stderr, "Failed read bands lines %d-%d (count: %d) !\n", i, i + rows - 1, count);
+                status = -1;
+            }
+            #ifdef READ_PRINTS
+            else
+                fprintf(stdout, "Read bands lines %d-%d (count: %d) !\n", i, i + rows - 1, count);
+            #endif
 
-            strip_list_add(write_buffer, curr_strip_index, output_strip);
+            for (int b = 0; b < bands; b++)
+            {
+                for (int j = 0; j < rows; j++)
+                {
+                    strip input_strip = strip_alloc(x_size, type);
 
-            if(strip_list_get_access(read_buffer, curr_strip_index) >= 3)
-                strip_list_remove_by_index(read_buffer, curr_strip_index);
+                    memcpy(input_strip, chunk + ((size_t)b * (size_t)rows + (size_t)j) * row_bytes, row_bytes);
 
-            if(strip_list_get_access(read_buffer, prev_strip_index) >= 3)
-                strip_list_remove_by_index(read_buffer, prev_strip_index);
+                    if (strip_list_add_shared(buffers[b], i + j, input_strip, get_strip_uses(i + j, slab_first, slab_last, radius)) != 0)
+                    {
+                        CPLFree(input_strip);
+                        status = -1;
+                    }
+                }
+            }
 
-            if(strip_list_get_access(read_buffer, next_strip_index) >= 3)
-                strip_list_remove_by_index(read_buffer, next_strip_index);
+            stats_add(STAGE_READ, 0, start_time);
+        }
 
-            #pragma omp atomic
-            count++;
+        CPLFree(chunk);
 
-            #ifdef FILTER_PRINTS
-            fprintf(stdout, "Thread %d -> Process band %d line %d (count: %d) !\n", omp_get_thread_num(), band_index, curr_strip_index, count);
-            #endif
-        }
+        if (last_row == y_size)
+            fprintf(stdout, "\nBands READ end !\n");
 
-        fprintf(stdout, "\nBand %d FILTER end !\n", band_index);
+        return status;
     }
-#else
-    void filter_tiff(strip_list* read_buffer, strip_list* write_buffer, int x_size, int y_size, int band_index, const int kern[3][3])
-    {   
-        const float lineal_kern[9] =
-        {
-            (float)kern[0][0], (float)kern[1][0], (float)kern[2][0],
-            (float)kern[0][1], (float)kern[1][1], (float)kern[2][1],
-            (float)kern[0][2], (float)kern[1][2], (float)kern[2][2]
-        };
-
-        int prev_strip_index = 0;
-        int curr_strip_index;
-        int next_strip_index = 1;
-    
-        strip prev_strip = NULL;
-        strip curr_strip = NULL;
-        strip next_strip = NULL;
-    
-        strip output_strip;
+#endif
 
-        int count = 0;
-    
-        for(int i = 0; i < y_size; i++)
+int filter_tiff(strip_list* read_buffer, strip_list* write_buffer, int x_size, int y_size, int band_index, GDALDataType type, const kernel* kern, const process_options* options, int first_row, int last_row)
+{
+    int count = 0;
+    int status = 0;
+    GDALDataType sum_type = get_sum_type(kern, type);
+
+    /* Float sums are quantized in place when the output is Float32 too */
+    int in_place = (sum_type == options->output_type);
+    int identity = in_place && options->scale == 1 && options->offset == 0;
+
+    /* Each task filters filter_grainsize rows and keeps its sums and the scratch row of a separable
+       kernel across them */
+    #ifdef PARALLEL_PROCESSING
+        #pragma omp taskloop grainsize(1) shared(read_buffer, write_buffer, x_size, y_size, type, sum_type, in_place, identity, first_row, last_row, kern, options, count, status)
+    #endif
+    for(int block = first_row; block < last_row; block += filter_grainsize)
+    {
+        int block_last = (block + filter_grainsize > last_row) ? last_row : block + filter_grainsize;
+        strip sums = in_place ? NULL : strip_alloc(x_size, sum_type);
+        float* scratch = (sum_type == GDT_Float32 && kern->separable) ? (float*) strip_alloc(x_size, GDT_Float32) : NULL;
+
+        for(int i = block; i < block_last; i++)
         {
-            curr_strip_index = i;
-    
-            while (!(curr_strip = strip_list_get(read_buffer, curr_strip_index)));
-            while (!(prev_strip = strip_list_get(read_buffer, prev_strip_index)));
-            while (!(next_strip = strip_list_get(read_buffer, next_strip_index)));
-    
-            output_strip = strip_alloc(x_size);
-            
-            apply_kern(prev_strip, curr_strip, next_strip, output_strip, lineal_kern, x_size);
-    
-            strip_list_add(write_buffer, curr_strip_index, output_strip);
-    
+            double start_time = stats_start();
+            strip rows[kern->size];
+            strip output_strip;
+            strip row_sums;
+            int missing = 0;
+
+            for (int k = 0; k < kern->size; k++)
+                if (!(rows[k] = strip_list_get(read_buffer, clamp_index(i + k - kern->radius, y_size))))
+                    missing = 1;
+
+            if (missing)
+            {
+                #ifdef PARALLEL_PROCESSING
+                    fprintf(stderr, "Thread %d -> Missing strips to filter band %d line %d !\n", omp_get_thread_num(), band_index, i);
+                #else
+                    fprintf(stderr, "Missing strips to filter band %d line %d !\n", band_index, i);
+                #endif
+
+                #ifdef PARALLEL_PROCESSING
+                    #pragma omp atomic write
+                #endif
+                status = -1;
+
+                continue;
+            }
+
+            output_strip = strip_alloc(x_size, options->output_type);
+            row_sums = in_place ? output_strip : sums;
+
+            /* Float sums come with float strips, see get_kernel_strip_type */
+            if (sum_type == GDT_Int32)
+                convolve_integer((const void* const*) rows, type, kern->integers, kern->bound, kern->size, kern->size, (int*) row_sums, x_size);
+            else
+                apply_kern((const float* const*) rows, (float*) row_sums, kern, x_size, scratch);
+
+            /* The sums are scaled, rounded and saturated here, on the parallel stage, so the writer hands
+               GDAL rows of the dataset type and no conversion happens under the dataset lock */
+            if (!identity)
+                quantize(row_sums, sum_type, options->scale, options->offset, output_strip, options->output_type, x_size);
+
+            if (strip_list_add(write_buffer, i, output_strip) != 0)
+            {
+                CPLFree(output_strip);
+
+                #ifdef PARALLEL_PROCESSING
+                    #pragma omp atomic write
+                #endif
+                status = -1;
+            }
+
+            for (int k = clamp_index(i - kern->radius, y_size); k <= clamp_index(i + kern->radius, y_size); k++)
+                strip_list_release(read_buffer, k);
+
+            stats_add(STAGE_FILTER, band_index, start_time);
+
+            #ifdef PARALLEL_PROCESSING
+                #pragma omp atomic
+            #endif
             count++;
 
             #ifdef FILTER_PRINTS
-            fprintf(stdout, "Process band %d line %d (count: %d) !\n", band_index, curr_strip_index, count);
+                #ifdef PARALLEL_PROCESSING
+                    fprintf(stdout, "Thread %d -> Process band %d line %d (count: %d) !\n", omp_get_thread_num(), band_index, i, count);
+                #else
+                    fprintf(stdout, "Process band %d line %d (count: %d) !\n", band_index, i, count);
+                #endif
             #endif
-
-            prev_strip_index = curr_strip_index;
-            next_strip_index = (curr_strip_index + 2 < y_size) ? curr_strip_index + 1 : curr_strip_index;
         }
-    
-        fprintf(stdout, "\nBand %d FILTER end !\n", band_index);
+
+        CPLFree(sums);
+        CPLFree(scratch);
     }
-#endif
+
+    if (last_row == y_size)
+        fprintf(stdout, "\nBand %d FILTER end !\n", band_index);
+
+    return status;
+}
 
 #ifdef PARALLEL_PROCESSING
-    void write_tiff(strip_list* buffer, GDALDatasetH dataset, omp_lock_t* dataset_mutex, int x_size, int y_size, int band_index)
+    int write_tiff(strip_list* buffer, dataset_pool* pool, int x_size, int y_size, int band_index, GDALDataType type, int first_row, int last_row, int output_first_row)
     {
         int count = 0;
+        int status = 0;
+        size_t row_bytes = (size_t)GDALGetDataTypeSizeBytes(type) * (size_t)x_size;
         strip current = NULL;
+        char* chunk;
+        int chunk_rows;
+        int rows;
 
-        GDALRasterBandH band = GDALGetRasterBand(dataset, band_index);
+        GDALRasterBandH band = GDALGetRasterBand(dataset_pool_acquire(pool), band_index);
+
+        chunk_rows = (band != NULL) ? get_chunk_rows(band, y_size) : 0;
+
+        dataset_pool_release(pool);
 
         if (band == NULL)
         {
             fprintf(stderr, "Failed on get band %d !\n", band_index);
-            return;
-        }  
+            return -1;
+        }
 
-        #pragma omp taskloop grainsize(1) private(current) shared(buffer, dataset_mutex, band_index, y_size, x_size, count)
-        for(int i = 0; i < y_size; i++) 
+        #pragma omp taskloop grainsize(1) private(band, current, chunk, rows) shared(buffer, pool, band_index, type, row_bytes, first_row, last_row, output_first_row, x_size, chunk_rows, count, status)
+        for(int i = first_row; i < last_row; i += chunk_rows) 
         {
-            while(!(current = strip_list_get(buffer, i)));
+            double start_time = stats_start();
+
+            rows = (i + chunk_rows > last_row) ? (last_row - i) : chunk_rows;
+
+            chunk = strip_alloc(x_size * rows, type);
+
+            for (int j = 0; j < rows; j++)
+            {
+                /* A missing strip is a broken dependency of the graph: the band fails, and its row is
+                   written as zeros rather than with the leftovers of the chunk */
+                if (!(current = strip_list_get(buffer, i + j)))
+                {
+                    fprintf(stderr, "Thread %d -> Missing strip to write band %d line %d !\n", omp_get_thread_num(), band_index, i + j);
+
+                    memset(chunk + (size_t)j * row_bytes, 0, row_bytes);
+
+                    #pragma omp atomic write
+                    status = -1;
+
+                    continue;
+                }
+
+                memcpy(chunk + (size_t)j * row_bytes, current, row_bytes);
+
+                strip_list_release(buffer, i + j);
+            }
 
             #pragma omp atomic
-            count++;
+            count += rows;
 
-            omp_set_lock(dataset_mutex);
+            band = GDALGetRasterBand(dataset_pool_acquire(pool), band_index);
 
-            if (GDALRasterIO(band, GF_Write, 0, i, x_size, 1, current, x_size, 1, GDT_Float32, 0, 0) != CE_None)
-                fprintf(stderr, "Thread %d -> Failed write band %d line %d (count: %d) !\n", omp_get_thread_num(), band_index, i, count);
+            if (GDALRasterIO(band, GF_Write, 0, i - output_first_row, x_size, rows, chunk, x_size, rows, type, 0, 0) != CE_None)
+            {
+                fprintf(stderr, "Thread %d -> Failed write band %d lines %d-%d (count: %d) !\n", omp_get_thread_num(), band_index, i, i + rows - 1, count);
+
+                #pragma omp atomic write
+                status = -1;
+            }
             #ifdef WRITE_PRINTS
             else
-                fprintf(stdout, "Thread %d -> Write band %d line %d (count: %d) !\n", omp_get_thread_num(), band_index, i, count);
+                fprintf(stdout, "Thread %d -> Write band %d lines %d-%d (count: %d) !\n", omp_get_thread_num(), band_index, i, i + rows - 1, count);
             #endif
 
-            omp_unset_lock(dataset_mutex);
+            dataset_pool_release(pool);
+
+            CPLFree(chunk);
 
-            strip_list_remove_by_index(buffer, i);
+            stats_add(STAGE_WRITE, band_index, start_time);
         }
 
-        fprintf(stdout, "\nBand %d WRITE end !\n", band_index);
+        if (last_row == y_size)
+            fprintf(stdout, "\nBand %d WRITE end !\n", band_index);
+
+        return status;
     }
 #else
-    void write_tiff(strip_list* buffer, GDALDatasetH dataset, int x_size, int y_size, int band_index)
+    int write_tiff(strip_list* buffer, GDALDatasetH dataset, int x_size, int y_size, int band_index, GDALDataType type, int first_row, int last_row, int output_first_row)
     {
         int count = 0;
+        int status = 0;
+        size_t row_bytes = (size_t)GDALGetDataTypeSizeBytes(type) * (size_t)x_size;
         strip current = NULL;
+        char* chunk;
+        int chunk_rows;
+        int rows;
 
         GDALRasterBandH band = GDALGetRasterBand(dataset, band_index);
 
         if (band == NULL)
         {
             fprintf(stderr, "Failed on get band %d !\n", band_index);
-            return;
+            return -1;
         }  
 
-        for(int i = 0; i < y_size; i++) 
+        chunk_rows = get_chunk_rows(band, y_size);
+
+        chunk = strip_alloc(x_size * chunk_rows, type);
+
+        for(int i = first_row; i < last_row; i += chunk_rows) 
         {
-            while(!(current = strip_list_get(buffer, i)));
+            double start_time = stats_start();
 
-            count++;
+            rows = (i + chunk_rows > last_row) ? (last_row - i) : chunk_rows;
+
+            for (int j = 0; j < rows; j++)
+            {
+                if (!(current = strip_list_get(buffer, i + j)))
+                {
+                    fprintf(stderr, "Missing strip to write band %d line %d !\n", band_index, i + j);
+
+                    memset(chunk + (size_t)j * row_bytes, 0, row_bytes);
+                    status = -1;
+
+                    continue;
+                }
+
+                memcpy(chunk + (size_t)j * row_bytes, current, row_bytes);
 
-            if (GDALRasterIO(band, GF_Write, 0, i, x_size, 1, current, x_size, 1, GDT_Float32, 0, 0) != CE_None)
-                fprintf(stderr, "Failed write band %d line %d (count: %d) !\n", band_index, i, count);
+                strip_list_release(buffer, i + j);
+            }
+
+            count += rows;
+
+            if (GDALRasterIO(band, GF_Write, 0, i - output_first_row, x_size, rows, chunk, x_size, rows, type, 0, 0) != CE_None)
+            {
+                fprintf(stderr, "Failed write band %d lines %d-%d (count: %d) !\n", band_index, i, i + rows - 1, count);
+                status = -1;
+            }
             #ifdef WRITE_PRINTS
             else
-                fprintf(stdout, "Write band %d line %d (count: %d) !\n", band_index, i, count);
+                fprintf(stdout, "Write band %d lines %d-%d (count: %d) !\n", band_index, i, i + rows - 1, count);
             #endif
+
+            stats_add(STAGE_WRITE, band_index, start_time);
+        }
+
+        CPLFree(chunk);
+
+        if (last_row == y_size)
+            fprintf(stdout, "\nBand %d WRITE end !\n", band_index);
+
+        return status;
+    }
+#endif
+
+void filter_tile(const void* input_rows, int input_first_row, void* output_rows, int x_size, int y_size, GDALDataType type, const kernel* kern, const process_options* options, int first_row, int last_row, int first_column, int last_column)
+{
+    GDALDataType sum_type = get_sum_type(kern, type);
+    size_t input_pixel = (size_t)GDALGetDataTypeSizeBytes(type);
+    size_t output_pixel = (size_t)GDALGetDataTypeSizeBytes(options->output_type);
+    size_t sum_pixel = (size_t)GDALGetDataTypeSizeBytes(sum_type);
+
+    /* The window adds the halo columns inside the image. Its edge columns are clamped by the convolution,
+       which is only right on the edges of the image, so only the columns of the tile are kept. */
+    int first_window_column = (first_column > kern->radius) ? first_column - kern->radius : 0;
+    int last_window_column = (last_column + kern->radius < x_size) ? last_column + kern->radius : x_size;
+    int window_width = last_window_column - first_window_column;
+    size_t tile_offset = (size_t)(first_column - first_window_column);
+
+    strip sums = strip_alloc(window_width, sum_type);
+    float* scratch = (sum_type == GDT_Float32 && kern->separable) ? (float*) strip_alloc(window_width, GDT_Float32) : NULL;
+    strip rows[kern->size];
+
+    /* Float sums of integer rows take them from a rolling window of kern->size rows converted to floats, as
+       the stages of a chain: row r is held on slot r % kern->size, so each row is converted once per tile */
+    int convert = (sum_type == GDT_Float32 && type != GDT_Float32);
+    float* window = convert ? (float*) strip_alloc(window_width * kern->size, GDT_Float32) : NULL;
+    int window_rows[kern->size];
+
+    for (int k = 0; k < kern->size; k++)
+        window_rows[k] = -1;
+
+    for (int i = first_row; i < last_row; i++)
+    {
+        for (int k = 0; k < kern->size; k++)
+        {
+            int row = clamp_index(i + k - kern->radius, y_size);
+            const char* input = (const char*) input_rows + ((size_t)(row - input_first_row) * (size_t)x_size + (size_t)first_window_column) * input_pixel;
+
+            if (!convert)
+            {
+                rows[k] = (strip) input;
+                continue;
+            }
+
+            float* slot = window + (size_t)(row % kern->size) * (size_t)window_width;
+
+            if (window_rows[row % kern->size] != row)
+            {
+                GDALCopyWords((void*) input, type, (int)input_pixel, slot, GDT_Float32, (int)sizeof(float), window_width);
+                window_rows[row % kern->size] = row;
+            }
+
+            rows[k] = slot;
         }
 
-        fprintf(stdout, "\nBand %d WRITE end !\n", band_index);
+        if (sum_type == GDT_Int32)
+            convolve_integer((const void* const*) rows, type, kern->integers, kern->bound, kern->size, kern->size, (int*) sums, window_width);
+        else
+            apply_kern((const float* const*) rows, (float*) sums, kern, window_width, scratch);
+
+        quantize((char*) sums + tile_offset * sum_pixel, sum_type, options->scale, options->offset, (char*) output_rows + ((size_t)(i - first_row) * (size_t)x_size + (size_t)first_column) * output_pixel, options->output_type, last_column - first_column);
+    }
+
+    CPLFree(window);
+    CPLFree(scratch);
+    CPLFree(sums);
+}
+
+#ifdef PARALLEL_PROCESSING
+    void transfer_rows(void* rows, dataset_pool* pool, int x_size, int band_index, GDALDataType type, GDALRWFlag rw_flag, int first_row, int last_row)
+    {
+        double start_time = stats_start();
+        GDALRasterBandH band = GDALGetRasterBand(dataset_pool_acquire(pool), band_index);
+
+        if (band == NULL)
+            fprintf(stderr, "Thread %d -> Failed on get band %d !\n", omp_get_thread_num(), band_index);
+        else if (GDALRasterIO(band, rw_flag, 0, first_row, x_size, last_row - first_row, rows, x_size, last_row - first_row, type, 0, 0) != CE_None)
+            fprintf(stderr, "Thread %d -> Failed %s band %d lines %d-%d !\n", omp_get_thread_num(), (rw_flag == GF_Read) ? "read" : "write", band_index, first_row, last_row - 1);
+
+        dataset_pool_release(pool);
+
+        stats_add((rw_flag == GF_Read) ? STAGE_READ : STAGE_WRITE, band_index, start_time);
+    }
+#else
+    void transfer_rows(void* rows, GDALDatasetH dataset, int x_size, int band_index, GDALDataType type, GDALRWFlag rw_flag, int first_row, int last_row)
+    {
+        double start_time = stats_start();
+        GDALRasterBandH band = GDALGetRasterBand(dataset, band_index);
+
+        if (band == NULL)
+            fprintf(stderr, "Failed on get band %d !\n", band_index);
+        else if (GDALRasterIO(band, rw_flag, 0, first_row, x_size, last_row - first_row, rows, x_size, last_row - first_row, type, 0, 0) != CE_None)
+            fprintf(stderr, "Failed %s band %d lines %d-%d !\n", (rw_flag == GF_Read) ? "read" : "write", band_index, first_row, last_row - 1);
+
+        stats_add((rw_flag == GF_Read) ? STAGE_READ : STAGE_WRITE, band_index, start_time);
     }
-#endif
\ No newline at end of file
+#endif
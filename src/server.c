@@ -0,0 +1,768 @@
+#include "server.h"
+#include "main.h"
+
+/* Define struct to store the state shared by the thread accepting the jobs and the thread running them */
+typedef struct server_state
+{
+    server_job** queue;                 // Ring of the jobs waiting to run
+    int depth;                          // Size of the ring
+    int head;                           // Position of the next job to run in the ring
+    int queued;                         // Jobs waiting to run
+    int running;                        // 1 while a job runs
+    int done;                           // Jobs run
+    int failed;                         // Jobs run that failed
+    int rejected;                       // Jobs turned away with BUSY
+    int stopping;                       // Set by a SHUTDOWN request, no job is admitted after it
+    int connections;                    // Connections whose request is being read by their own thread
+    int listen_fd;                      // Socket the connections are accepted on
+    const process_options* options;     // Options of the jobs before their own ones are applied
+    pthread_mutex_t mutex;              // Lock of the fields above
+    pthread_cond_t wake;                // Signaled when a job is queued, a connection ends or the server stops
+} server_state;
+
+/* Define struct to store a connection handed to the thread that reads its request */
+typedef struct server_connection
+{
+    server_state* state;                // State of the server
+    int fd;                             // Connection of the client
+} server_connection;
+
+/**
+ * @brief Send a reply line to a client. A client that is gone does not raise SIGPIPE.
+ *
+ * @param fd The connection of the client.
+ * @param format The format of the reply, without the new line.
+ *
+ * @return void.
+*/
+void server_reply(int fd, const char* format, ...)
+{
+    char line[SERVER_LINE_MAX];
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+
+    if (length < 0)
+        return;
+
+    if (length > (int) sizeof(line) - 2)
+        length = (int) sizeof(line) - 2;
+
+    line[length++] = '\n';
+
+    if (send(fd, line, (size_t) length, MSG_NOSIGNAL) < 0)
+        fprintf(stderr, "Failed on send reply: %s !\n", strerror(errno));
+}
+
+/**
+ * @brief Read a line from a connection. Requests are short, so the line is read one byte at a time and
+ *        nothing after it is consumed.
+ *
+ * @param fd The connection.
+ * @param line The line, without its new line.
+ * @param size The size of the line buffer.
+ *
+ * @return int 0 on success, -1 if the connection ends, times out or the line does not fit.
+*/
+int server_read_line(int fd, char* line, size_t size)
+{
+    size_t length = 0;
+
+    while (length + 1 < size)
+    {
+        if (recv(fd, line + length, 1, 0) != 1)
+            return -1;
+
+        if (line[length] == '\n')
+        {
+            if (length > 0 && line[length - 1] == '\r')
+                length--;
+
+            line[length] = '\0';
+            return 0;
+        }
+
+        length++;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Parse the options of a JOB request over the options of the server. Only the text is checked
+ *        here, the kernel and the chain are loaded when the job runs.
+ *
+ * @param job The job, with its tokens.
+ * @param error The reason the request is invalid.
+ * @param size The size of the error buffer.
+ *
+ * @return int 0 on success, -1 if the request is invalid.
+*/
+int server_parse_job(server_job* job, char* error, size_t size)
+{
+    const char* const engines[] = { "strips", "tiles", NULL };
+    const char* choice;
+
+    if (CSLCount(job->tokens) < 3)
+    {
+        snprintf(error, size, "Expected JOB <input_path> <output_path> [options]");
+        return -1;
+    }
+
+    job->input_path = job->tokens[1];
+    job->output_path = job->tokens[2];
+
+    for (int i = 3; job->tokens[i] != NULL; i += 2)
+    {
+        const char* name = job->tokens[i];
+        const char* value = job->tokens[i + 1];
+
+        if (value == NULL)
+        {
+            snprintf(error, size, "Missing value of %s", name);
+            return -1;
+        }
+
+        if (strcmp(name, "--kernel") == 0)
+        {
+            /* A kernel replaces the chain of the server */
+            job->kernel_name = value;
+            job->options.chain = NULL;
+        }
+        else if (strcmp(name, "--chain") == 0)
+        {
+            job->chain_steps = value;
+        }
+        else if (strcmp(name, "--engine") == 0)
+        {
+            if ((choice = parse_choice(value, engines)) == NULL)
+            {
+                snprintf(error, size, "Invalid engine: %s", value);
+                return -1;
+            }
+
+            job->options.engine = (choice == engines[1]) ? ENGINE_TILES : ENGINE_STRIPS;
+        }
+        else if (strcmp(name, "--output-type") == 0)
+        {
+            if (parse_output_type(value, &job->options.output_type) != 0)
+            {
+                snprintf(error, size, "Invalid output type: %s", value);
+                return -1;
+            }
+        }
+        else if (strcmp(name, "--scale") == 0)
+        {
+            if (parse_float(value, &job->options.scale) != 0)
+            {
+                snprintf(error, size, "Invalid scale: %s", value);
+                return -1;
+            }
+        }
+        else if (strcmp(name, "--offset") == 0)
+        {
+            if (parse_float(value, &job->options.offset) != 0)
+            {
+                snprintf(error, size, "Invalid offset: %s", value);
+                return -1;
+            }
+        }
+        else
+        {
+            snprintf(error, size, "Unknown job option: %s", name);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Free a job and close its connection.
+ *
+ * @param job The job to free.
+ *
+ * @return void.
+*/
+void server_free_job(server_job* job)
+{
+    close(job->fd);
+    CSLDestroy(job->tokens);
+    free(job);
+}
+
+/**
+ * @brief Filter the file of a job. Unlike process_file, a file that can not be opened or created fails the
+ *        job instead of ending the server.
+ *
+ * @param job The job.
+ * @param kern The kernel to be applied.
+ * @param options The options of the job.
+ *
+ * @return double The time taken to filter the file, or a negative value on error.
+*/
+double server_process_file(const server_job* job, const kernel* kern, const process_options* options)
+{
+    GDALDatasetH input_dataset = GDALOpen(job->input_path, GA_ReadOnly);
+
+    if (input_dataset == NULL)
+    {
+        fprintf(stderr, "Failed on open file %s !\n", job->input_path);
+        return -1;
+    }
+
+    int x_size = GDALGetRasterXSize(input_dataset);
+    int y_size = GDALGetRasterYSize(input_dataset);
+
+    GDALDatasetH output_dataset = create_output_dataset(input_dataset, job->output_path, options);
+
+    if (output_dataset == NULL)
+    {
+        fprintf(stderr, "Failed on create output dataset %s !\n", job->output_path);
+        GDALClose(input_dataset);
+        return -1;
+    }
+
+    #ifdef PARALLEL_PROCESSING
+        /* As in process_file, the handles of a parallel write rewrite the blocks written by the close */
+        if (options->parallel_write && dataset_supports_parallel_write(output_dataset))
+        {
+            GDALClose(output_dataset);
+
+            if ((output_dataset = GDALOpen(job->output_path, GA_Update)) == NULL)
+            {
+                fprintf(stderr, "Failed on open output dataset %s !\n", job->output_path);
+                GDALClose(input_dataset);
+                return -1;
+            }
+        }
+    #endif
+
+    double time = (options->engine == ENGINE_TILES) ? process_dataset_tiles(input_dataset, output_dataset, kern, x_size, y_size, 0, y_size, options) : process_dataset(input_dataset, output_dataset, kern, x_size, y_size, 0, y_size, options);
+
+    GDALClose(input_dataset);
+    GDALClose(output_dataset);
+
+    return time;
+}
+
+/**
+ * @brief Run a job and reply its timings to its client: the time it waited in the queue, the time of the
+ *        filtering, the time from its admission to its end, the busy time of each stage summed over the
+ *        threads and the throughput.
+ *
+ * @param job The job.
+ * @param kern The kernel of the server.
+ *
+ * @return int 0 on success, -1 if the job failed.
+*/
+int server_run_job(const server_job* job, const kernel* kern)
+{
+    process_options options = job->options;
+    kernel* job_kern = NULL;
+    chain* job_chain = NULL;
+    double start_time = stats_now();
+
+    if (job->kernel_name && (job_kern = kernel_load(job->kernel_name)) == NULL)
+    {
+        server_reply(job->fd, "ERROR Failed on load kernel %s", job->kernel_name);
+        return -1;
+    }
+
+    if (job->chain_steps)
+    {
+        if ((job_chain = chain_load(job->chain_steps)) == NULL)
+        {
+            server_reply(job->fd, "ERROR Failed on load chain %s", job->chain_steps);
+            kernel_free(job_kern);
+            return -1;
+        }
+
+        options.chain = job_chain;
+    }
+
+    /* The stages of a chain are fused on the tiles, the strip engine only applies one kernel. The chain may
+       also be the one of the server, kept by a job that only changes the engine. */
+    if (options.chain)
+        options.engine = ENGINE_TILES;
+
+    fprintf(stdout, "\nStarting job %s !\n", job->output_path);
+
+    stats_reset();
+
+    double time = server_process_file(job, job_kern ? job_kern : kern, &options);
+    double end_time = stats_now();
+
+    if (time < 0)
+        server_reply(job->fd, "ERROR Failed on filter %s into %s", job->input_path, job->output_path);
+    else
+        server_reply(job->fd, "OK wait=%.6f time=%.6f total=%.6f read=%.6f filter=%.6f write=%.6f mpixels=%.2f",
+                     start_time - job->submitted, time, end_time - job->submitted, stats_get_busy(STAGE_READ), stats_get_busy(STAGE_FILTER),
+                     stats_get_busy(STAGE_WRITE), (time > 0) ? (double) stats_get_pixels() / time / 1e6 : 0);
+
+    fprintf(stdout, "\nEnding job %s (%f seconds) !\n", job->output_path, end_time - start_time);
+
+    kernel_free(job_kern);
+    chain_free(job_chain);
+
+    return (time < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Handle one connection: answer STATUS and SHUTDOWN requests, and queue JOB requests while the
+ *        queue has room, rejecting them with BUSY otherwise. A SHUTDOWN request also shuts the listening
+ *        socket down, which ends the accept loop.
+ *
+ * @param state The state of the server.
+ * @param fd The connection.
+ *
+ * @return void.
+*/
+void server_handle(server_state* state, int fd)
+{
+    const struct timeval timeout = { .tv_sec = SERVER_READ_TIMEOUT, .tv_usec = 0 };
+    char line[SERVER_LINE_MAX];
+    char error[SERVER_LINE_MAX];
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if (server_read_line(fd, line, sizeof(line)) != 0)
+    {
+        server_reply(fd, "ERROR Expected one request line");
+        close(fd);
+        return;
+    }
+
+    char** tokens = CSLTokenizeString2(line, " \t", CSLT_HONOURSTRINGS);
+
+    if (CSLCount(tokens) == 1 && strcasecmp(tokens[0], "STATUS") == 0)
+    {
+        pthread_mutex_lock(&state->mutex);
+        server_reply(fd, "OK queued=%d running=%d done=%d failed=%d rejected=%d", state->queued, state->running, state->done, state->failed, state->rejected);
+        pthread_mutex_unlock(&state->mutex);
+
+        CSLDestroy(tokens);
+        close(fd);
+        return;
+    }
+
+    if (CSLCount(tokens) == 1 && strcasecmp(tokens[0], "SHUTDOWN") == 0)
+    {
+        pthread_mutex_lock(&state->mutex);
+        state->stopping = 1;
+        shutdown(state->listen_fd, SHUT_RDWR);
+        pthread_cond_signal(&state->wake);
+        pthread_mutex_unlock(&state->mutex);
+
+        server_reply(fd, "OK");
+
+        CSLDestroy(tokens);
+        close(fd);
+        return;
+    }
+
+    if (CSLCount(tokens) == 0 || strcasecmp(tokens[0], "JOB") != 0)
+    {
+        server_reply(fd, "ERROR Expected JOB, STATUS or SHUTDOWN");
+        CSLDestroy(tokens);
+        close(fd);
+        return;
+    }
+
+    server_job* job = (server_job*) calloc(1, sizeof(server_job));
+
+    job->fd = fd;
+    job->tokens = tokens;
+    job->options = *state->options;
+
+    if (server_parse_job(job, error, sizeof(error)) != 0)
+    {
+        server_reply(fd, "ERROR %s", error);
+        server_free_job(job);
+        return;
+    }
+
+    pthread_mutex_lock(&state->mutex);
+
+    /* The requests are read concurrently, one may arrive after a SHUTDOWN request */
+    if (state->stopping)
+    {
+        pthread_mutex_unlock(&state->mutex);
+
+        server_reply(fd, "ERROR Server is stopping");
+        server_free_job(job);
+        return;
+    }
+
+    /* Admission control: a full queue turns the job away at once instead of letting the latency of every
+       job grow, so the client can retry later or send it to another node */
+    if (state->queued == state->depth)
+    {
+        state->rejected++;
+        pthread_mutex_unlock(&state->mutex);
+
+        server_reply(fd, "BUSY queued=%d", state->depth);
+        server_free_job(job);
+        return;
+    }
+
+    job->submitted = stats_now();
+
+    state->queue[(state->head + state->queued) % state->depth] = job;
+    state->queued++;
+
+    pthread_cond_signal(&state->wake);
+    pthread_mutex_unlock(&state->mutex);
+}
+
+/**
+ * @brief Read and handle the request of a connection, on a thread of its own.
+ *
+ * @param arg The connection, freed here.
+ *
+ * @return void* NULL.
+*/
+void* server_connection_run(void* arg)
+{
+    server_connection* connection = (server_connection*) arg;
+    server_state* state = connection->state;
+
+    server_handle(state, connection->fd);
+
+    pthread_mutex_lock(&state->mutex);
+    state->connections--;
+    pthread_cond_signal(&state->wake);
+    pthread_mutex_unlock(&state->mutex);
+
+    free(connection);
+
+    return NULL;
+}
+
+/**
+ * @brief Accept the connections of the clients until a SHUTDOWN request. Each request is read by a thread
+ *        of its own, so a client slow to send it does not delay the other ones; when SERVER_CONNECTIONS_MAX
+ *        requests are already being read, a new connection is answered BUSY at once.
+ *
+ * @param arg The state of the server.
+ *
+ * @return void* NULL.
+*/
+void* server_accept(void* arg)
+{
+    server_state* state = (server_state*) arg;
+    pthread_t thread;
+
+    while (1)
+    {
+        int fd = accept(state->listen_fd, NULL, NULL);
+
+        if (fd < 0)
+        {
+            int error = errno;
+
+            if (error == EINTR || error == ECONNABORTED)
+                continue;
+
+            /* The jobs already queued still run */
+            pthread_mutex_lock(&state->mutex);
+
+            if (!state->stopping)
+                fprintf(stderr, "Failed on accept connection: %s !\n", strerror(error));
+
+            state->stopping = 1;
+            pthread_cond_signal(&state->wake);
+            pthread_mutex_unlock(&state->mutex);
+
+            return NULL;
+        }
+
+        pthread_mutex_lock(&state->mutex);
+
+        int full = (state->connections == SERVER_CONNECTIONS_MAX);
+
+        if (full)
+            state->rejected++;
+        else
+            state->connections++;
+
+        pthread_mutex_unlock(&state->mutex);
+
+        if (full)
+        {
+            server_reply(fd, "BUSY connections=%d", SERVER_CONNECTIONS_MAX);
+            close(fd);
+            continue;
+        }
+
+        server_connection* connection = (server_connection*) malloc(sizeof(server_connection));
+
+        connection->state = state;
+        connection->fd = fd;
+
+        /* Without a thread the request is read here, as a single threaded server would */
+        if (pthread_create(&thread, NULL, server_connection_run, connection) != 0)
+            server_connection_run(connection);
+        else
+            pthread_detach(thread);
+    }
+}
+
+/**
+ * @brief Fill the address of a socket path.
+ *
+ * @param address The address.
+ * @param socket_path The path of the socket.
+ *
+ * @return int 0 on success, -1 if the path is too long.
+*/
+int server_get_address(struct sockaddr_un* address, const char* socket_path)
+{
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+
+    if (strlen(socket_path) >= sizeof(address->sun_path))
+    {
+        fprintf(stderr, "Socket path %s is too long !\n", socket_path);
+        return -1;
+    }
+
+    strcpy(address->sun_path, socket_path);
+
+    return 0;
+}
+
+/**
+ * @brief Create the socket of the server. A socket file nobody accepts on is left by a server that is gone
+ *        and is replaced, any other file at the path is kept and fails the server.
+ *
+ * @param socket_path The path of the socket.
+ * @param backlog The connections waiting to be accepted.
+ *
+ * @return int The socket, or -1 on error.
+*/
+int server_listen(const char* socket_path, int backlog)
+{
+    struct sockaddr_un address;
+    struct stat info;
+
+    if (server_get_address(&address, socket_path) != 0)
+        return -1;
+
+    if (lstat(socket_path, &info) == 0)
+    {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        int alive = S_ISSOCK(info.st_mode) && probe >= 0 && connect(probe, (struct sockaddr*) &address, sizeof(address)) == 0;
+
+        if (probe >= 0)
+            close(probe);
+
+        if (!S_ISSOCK(info.st_mode))
+        {
+            fprintf(stderr, "%s exists and is not a socket !\n", socket_path);
+            return -1;
+        }
+
+        if (alive)
+        {
+            fprintf(stderr, "%s is in use by another server !\n", socket_path);
+            return -1;
+        }
+
+        unlink(socket_path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0 || bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || chmod(socket_path, S_IRUSR | S_IWUSR) != 0 || listen(fd, backlog) != 0)
+    {
+        fprintf(stderr, "Failed on listen on %s: %s !\n", socket_path, strerror(errno));
+
+        if (fd >= 0)
+            close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+int serve(const char* socket_path, const kernel* kern, const process_options* options, int queue_depth)
+{
+    server_state state = { .depth = queue_depth, .options = options };
+    pthread_t acceptor;
+
+    #ifdef MPI_PROCESSING
+        int rank, ranks;
+
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+        if (ranks > 1)
+        {
+            if (rank == 0)
+                fprintf(stderr, "The server runs on one rank, start it with a single rank !\n");
+
+            return -1;
+        }
+    #endif
+
+    if ((state.listen_fd = server_listen(socket_path, queue_depth)) < 0)
+        return -1;
+
+    state.queue = (server_job**) calloc((size_t) queue_depth, sizeof(server_job*));
+
+    pthread_mutex_init(&state.mutex, NULL);
+    pthread_cond_init(&state.wake, NULL);
+
+    #ifdef PARALLEL_PROCESSING
+        /* Start the threads of the pool now, so the first job does not pay for it. The runtime keeps them
+           between the parallel regions of the jobs. */
+        #pragma omp parallel
+        {
+        }
+    #endif
+
+    if (pthread_create(&acceptor, NULL, server_accept, &state) != 0)
+    {
+        fprintf(stderr, "Failed on start the acceptor thread !\n");
+        close(state.listen_fd);
+        unlink(socket_path);
+        free(state.queue);
+        return -1;
+    }
+
+    fprintf(stdout, "\nListening on %s, up to %d queued jobs !\n", socket_path, queue_depth);
+    fflush(stdout);
+
+    /* The jobs run on this thread, so their parallel regions use the pool started above */
+    while (1)
+    {
+        pthread_mutex_lock(&state.mutex);
+
+        while (state.queued == 0 && !state.stopping)
+            pthread_cond_wait(&state.wake, &state.mutex);
+
+        if (state.queued == 0)
+        {
+            pthread_mutex_unlock(&state.mutex);
+            break;
+        }
+
+        server_job* job = state.queue[state.head];
+
+        state.head = (state.head + 1) % state.depth;
+        state.queued--;
+        state.running = 1;
+
+        pthread_mutex_unlock(&state.mutex);
+
+        int status = server_run_job(job, kern);
+
+        server_free_job(job);
+
+        pthread_mutex_lock(&state.mutex);
+        state.running = 0;
+        state.done++;
+        state.failed += (status != 0);
+        pthread_mutex_unlock(&state.mutex);
+
+        fflush(stdout);
+    }
+
+    pthread_join(acceptor, NULL);
+
+    /* The threads still reading a request end within SERVER_READ_TIMEOUT, they use the state */
+    pthread_mutex_lock(&state.mutex);
+
+    while (state.connections > 0)
+        pthread_cond_wait(&state.wake, &state.mutex);
+
+    pthread_mutex_unlock(&state.mutex);
+
+    close(state.listen_fd);
+    unlink(socket_path);
+
+    fprintf(stdout, "\nServed %d jobs, %d failed, %d rejected !\n", state.done, state.failed, state.rejected);
+
+    pthread_cond_destroy(&state.wake);
+    pthread_mutex_destroy(&state.mutex);
+    free(state.queue);
+
+    return 0;
+}
+
+int submit(int argc, char* argv[])
+{
+    struct sockaddr_un address;
+    char line[SERVER_LINE_MAX];
+    size_t length = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Invalid number of arguments: [socket_path] [request] !\n");
+        return -1;
+    }
+
+    /* The request is the arguments after the socket path, quoted as CSLTokenizeString2 reads them back */
+    for (int i = 1; i < argc; i++)
+    {
+        int quote = argv[i][0] == '\0' || strpbrk(argv[i], " \t\"\\") != NULL;
+
+        /* Escaped, the argument takes up to twice its length, plus its separator, its quotes and the new line */
+        if (length + 2 * strlen(argv[i]) + 4 > sizeof(line))
+        {
+            fprintf(stderr, "Request is too long !\n");
+            return -1;
+        }
+
+        if (i > 1)
+            line[length++] = ' ';
+
+        if (quote)
+            line[length++] = '"';
+
+        for (const char* c = argv[i]; *c; c++)
+        {
+            if (quote && (*c == '"' || *c == '\\'))
+                line[length++] = '\\';
+
+            line[length++] = *c;
+        }
+
+        if (quote)
+            line[length++] = '"';
+    }
+
+    line[length++] = '\n';
+
+    if (server_get_address(&address, argv[0]) != 0)
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0 || connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0)
+    {
+        fprintf(stderr, "Failed on connect to %s: %s !\n", argv[0], strerror(errno));
+
+        if (fd >= 0)
+            close(fd);
+
+        return -1;
+    }
+
+    if (send(fd, line, length, MSG_NOSIGNAL) != (ssize_t) length || server_read_line(fd, line, sizeof(line)) != 0)
+    {
+        fprintf(stderr, "Failed on request to %s !\n", argv[0]);
+        close(fd);
+        return -1;
+    }
+
+    close(fd);
+
+    fprintf(stdout, "%s\n", line);
+
+    return (strncmp(line, "OK", 2) == 0) ? 0 : -1;
+}
@@ -0,0 +1,411 @@
+#include "counters.h"
+#include "stats.h"
+#include "trace.h"
+
+/* Define struct to store a copy of the counters, in nanoseconds from the last reset for the times */
+typedef struct stats_counters
+{
+    unsigned long long busy[STATS_MAX_BANDS + 1][STAGE_COUNT];     // Busy time of each band and stage
+    unsigned long long first[STATS_MAX_BANDS + 1][STAGE_COUNT];    // Start of the first work of each band and stage
+    unsigned long long last[STATS_MAX_BANDS + 1][STAGE_COUNT];     // End of the last work of each band and stage
+    unsigned long long read_peak[STATS_MAX_BANDS + 1];             // Peak strips of the read list of each band
+    unsigned long long write_peak[STATS_MAX_BANDS + 1];            // Peak strips of the write list of each band
+    unsigned long long accesses[STATS_MAX_BANDS + 1];              // Get accesses to the read list of each band
+    unsigned long long misses[STATS_MAX_BANDS + 1];                // Get accesses to strips not in the read list
+    unsigned long long lock_wait;                                  // Time waiting for the lock of shared datasets
+    unsigned long long rows;                                       // Filtered rows of every band
+} stats_counters;
+
+/* Counters updated by the threads without a lock */
+static atomic_ullong stage_busy[STATS_MAX_BANDS + 1][STAGE_COUNT];
+static atomic_ullong stage_first[STATS_MAX_BANDS + 1][STAGE_COUNT];
+static atomic_ullong stage_last[STATS_MAX_BANDS + 1][STAGE_COUNT];
+static atomic_ullong list_read_peak[STATS_MAX_BANDS + 1];
+static atomic_ullong list_write_peak[STATS_MAX_BANDS + 1];
+static atomic_ullong list_accesses[STATS_MAX_BANDS + 1];
+static atomic_ullong list_misses[STATS_MAX_BANDS + 1];
+static atomic_ullong lock_wait;
+static atomic_ullong rows_done;
+static atomic_ullong pixels_done;
+
+/* Time of the last reset, the spans are measured from it */
+static double epoch;
+
+static const char* const stage_names[STAGE_COUNT] = { "read", "filter", "write" };
+
+double stats_now(void)
+{
+    #ifdef PARALLEL_PROCESSING
+        return omp_get_wtime();
+    #else
+        return (double) clock() / CLOCKS_PER_SEC;
+    #endif
+}
+
+double stats_start(void)
+{
+    counters_start();
+
+    return stats_now();
+}
+
+/**
+ * @brief Convert a time to nanoseconds from the last reset.
+ *
+ * @param time The time, from stats_now.
+ *
+ * @return unsigned long long The nanoseconds from the last reset, 0 if the time is before it.
+*/
+static inline unsigned long long stats_to_ns(double time)
+{
+    return (time > epoch) ? (unsigned long long)((time - epoch) * 1e9) : 0;
+}
+
+/**
+ * @brief Clamp a band index to the bands with their own counters.
+ *
+ * @param band_index The band index.
+ *
+ * @return int The index of the counters of the band.
+*/
+static inline int stats_band(int band_index)
+{
+    return (band_index < 0) ? 0 : ((band_index > STATS_MAX_BANDS) ? STATS_MAX_BANDS : band_index);
+}
+
+/**
+ * @brief Lower an atomic counter to a value if it is below it.
+ *
+ * @param counter The counter.
+ * @param value The value.
+ *
+ * @return void.
+*/
+static inline void stats_min(atomic_ullong* counter, unsigned long long value)
+{
+    unsigned long long current = atomic_load_explicit(counter, memory_order_relaxed);
+
+    while (value < current && !atomic_compare_exchange_weak_explicit(counter, &current, value, memory_order_relaxed, memory_order_relaxed));
+}
+
+/**
+ * @brief Raise an atomic counter to a value if it is above it.
+ *
+ * @param counter The counter.
+ * @param value The value.
+ *
+ * @return void.
+*/
+static inline void stats_max(atomic_ullong* counter, unsigned long long value)
+{
+    unsigned long long current = atomic_load_explicit(counter, memory_order_relaxed);
+
+    while (value > current && !atomic_compare_exchange_weak_explicit(counter, &current, value, memory_order_relaxed, memory_order_relaxed));
+}
+
+void stats_add(process_stage stage, int band_index, double start_time)
+{
+    int band = stats_band(band_index);
+    double end_time = stats_now();
+    unsigned long long start = stats_to_ns(start_time);
+    unsigned long long end = stats_to_ns(end_time);
+
+    if (end < start)
+        end = start;
+
+    atomic_fetch_add_explicit(&stage_busy[band][stage], end - start, memory_order_relaxed);
+    stats_min(&stage_first[band][stage], start);
+    stats_max(&stage_last[band][stage], end);
+
+    counters_add(stage);
+    trace_add(stage, band_index, start_time, end_time);
+}
+
+void stats_add_lock_wait(double start_time)
+{
+    double end_time = stats_now();
+    double elapsed = end_time - start_time;
+
+    if (elapsed > 0)
+        atomic_fetch_add_explicit(&lock_wait, (unsigned long long)(elapsed * 1e9), memory_order_relaxed);
+
+    trace_add(TRACE_LOCK, 0, start_time, end_time);
+}
+
+void stats_add_lists(int band_index, int read_peak, int write_peak, unsigned long accesses, unsigned long misses)
+{
+    int band = stats_band(band_index);
+
+    stats_max(&list_read_peak[band], (unsigned long long)read_peak);
+    stats_max(&list_write_peak[band], (unsigned long long)write_peak);
+    atomic_fetch_add_explicit(&list_accesses[band], accesses, memory_order_relaxed);
+    atomic_fetch_add_explicit(&list_misses[band], misses, memory_order_relaxed);
+}
+
+void stats_add_rows(long rows, int x_size)
+{
+    atomic_fetch_add_explicit(&rows_done, (unsigned long long)rows, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pixels_done, (unsigned long long)rows * (unsigned long long)x_size, memory_order_relaxed);
+}
+
+unsigned long long stats_get_pixels(void)
+{
+    return atomic_load_explicit(&pixels_done, memory_order_relaxed);
+}
+
+void stats_reset(void)
+{
+    epoch = stats_now();
+
+    for (int b = 0; b <= STATS_MAX_BANDS; b++)
+    {
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+            atomic_store_explicit(&stage_busy[b][s], 0, memory_order_relaxed);
+            atomic_store_explicit(&stage_first[b][s], ~0ULL, memory_order_relaxed);
+            atomic_store_explicit(&stage_last[b][s], 0, memory_order_relaxed);
+        }
+
+        atomic_store_explicit(&list_read_peak[b], 0, memory_order_relaxed);
+        atomic_store_explicit(&list_write_peak[b], 0, memory_order_relaxed);
+        atomic_store_explicit(&list_accesses[b], 0, memory_order_relaxed);
+        atomic_store_explicit(&list_misses[b], 0, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&lock_wait, 0, memory_order_relaxed);
+    atomic_store_explicit(&rows_done, 0, memory_order_relaxed);
+    atomic_store_explicit(&pixels_done, 0, memory_order_relaxed);
+}
+
+double stats_get_busy(process_stage stage)
+{
+    unsigned long long busy = 0;
+
+    for (int b = 0; b <= STATS_MAX_BANDS; b++)
+        busy += atomic_load_explicit(&stage_busy[b][stage], memory_order_relaxed);
+
+    return (double) busy / 1e9;
+}
+
+const char* stats_get_stage_name(process_stage stage)
+{
+    return stage_names[stage];
+}
+
+/**
+ * @brief Copy the counters, gathered from every rank on MPI builds.
+ *
+ * @param counters The copy of the counters, complete on rank 0.
+ * @param threads The number of threads of all the ranks.
+ *
+ * @return int The rank of the caller.
+*/
+int stats_collect(stats_counters* counters, int* threads)
+{
+    stats_counters local;
+    int rank = 0;
+
+    for (int b = 0; b <= STATS_MAX_BANDS; b++)
+    {
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+            local.busy[b][s] = atomic_load_explicit(&stage_busy[b][s], memory_order_relaxed);
+            local.first[b][s] = atomic_load_explicit(&stage_first[b][s], memory_order_relaxed);
+            local.last[b][s] = atomic_load_explicit(&stage_last[b][s], memory_order_relaxed);
+        }
+
+        local.read_peak[b] = atomic_load_explicit(&list_read_peak[b], memory_order_relaxed);
+        local.write_peak[b] = atomic_load_explicit(&list_write_peak[b], memory_order_relaxed);
+        local.accesses[b] = atomic_load_explicit(&list_accesses[b], memory_order_relaxed);
+        local.misses[b] = atomic_load_explicit(&list_misses[b], memory_order_relaxed);
+    }
+
+    local.lock_wait = atomic_load_explicit(&lock_wait, memory_order_relaxed);
+    local.rows = atomic_load_explicit(&rows_done, memory_order_relaxed);
+
+    #ifdef PARALLEL_PROCESSING
+        *threads = omp_get_max_threads();
+    #else
+        *threads = 1;
+    #endif
+
+    #ifdef MPI_PROCESSING
+        /* Each rank measures its spans from its own reset, the ranks reset at the same time before the file */
+        int size = (STATS_MAX_BANDS + 1) * STAGE_COUNT;
+        int bands = STATS_MAX_BANDS + 1;
+        int local_threads = *threads;
+
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+        MPI_Reduce(local.busy, counters->busy, size, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(local.first, counters->first, size, MPI_UNSIGNED_LONG_LONG, MPI_MIN, 0, MPI_COMM_WORLD);
+        MPI_Reduce(local.last, counters->last, size, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(local.read_peak, counters->read_peak, bands, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(local.write_peak, counters->write_peak, bands, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(local.accesses, counters->accesses, bands, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(local.misses, counters->misses, bands, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&local.lock_wait, &counters->lock_wait, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&local.rows, &counters->rows, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&local_threads, threads, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    #else
+        memcpy(counters, &local, sizeof(stats_counters));
+    #endif
+
+    return rank;
+}
+
+/**
+ * @brief Check if a band has any counter.
+ *
+ * @param counters The counters.
+ * @param band The index of the counters of the band.
+ *
+ * @return int 1 if the band has work or strip lists, 0 otherwise.
+*/
+int stats_band_used(const stats_counters* counters, int band)
+{
+    for (int s = 0; s < STAGE_COUNT; s++)
+        if (counters->last[band][s] > 0)
+            return 1;
+
+    return counters->accesses[band] > 0;
+}
+
+/**
+ * @brief Get the span of a stage on a band, from the start of its first work to the end of its last one.
+ *
+ * @param counters The counters.
+ * @param band The index of the counters of the band.
+ * @param stage The stage.
+ *
+ * @return double The span, in seconds, 0 if the stage has no work on the band.
+*/
+double stats_span(const stats_counters* counters, int band, int stage)
+{
+    if (counters->last[band][stage] < counters->first[band][stage])
+        return 0;
+
+    return (double)(counters->last[band][stage] - counters->first[band][stage]) / 1e9;
+}
+
+void stats_print(FILE* file, double time)
+{
+    stats_counters* counters = (stats_counters*) malloc(sizeof(stats_counters));
+    int threads;
+
+    if (stats_collect(counters, &threads) != 0)
+    {
+        free(counters);
+        return;
+    }
+
+    double total_busy = 0;
+
+    fprintf(file, "\nPipeline statistics (%f seconds, %d threads):\n", time, threads);
+    fprintf(file, "\n  Band  Stage     Busy (s)     Span (s)     Idle (s)\n");
+
+    for (int b = 0; b <= STATS_MAX_BANDS; b++)
+    {
+        if (!stats_band_used(counters, b))
+            continue;
+
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+            double busy = (double) counters->busy[b][s] / 1e9;
+            double span = stats_span(counters, b, s);
+
+            total_busy += busy;
+
+            if (span == 0 && busy == 0)
+                continue;
+
+            char band[16] = "all";
+
+            if (b)
+                snprintf(band, sizeof(band), "%d", b);
+
+            fprintf(file, "  %4s  %-6s  %11.6f  %11.6f  %11.6f\n", band, stage_names[s], busy, span, (span > busy) ? span - busy : 0);
+        }
+    }
+
+    fprintf(file, "\n  Band  Read peak  Write peak     Accesses  Hit ratio\n");
+
+    for (int b = 1; b <= STATS_MAX_BANDS; b++)
+    {
+        if (counters->accesses[b] == 0)
+            continue;
+
+        fprintf(file, "  %4d  %9llu  %10llu  %11llu  %8.2f%%\n", b, counters->read_peak[b], counters->write_peak[b], counters->accesses[b], 100.0 * (double)(counters->accesses[b] - counters->misses[b]) / (double)counters->accesses[b]);
+    }
+
+    fprintf(file, "\nLock wait: %f seconds\n", (double) counters->lock_wait / 1e9);
+
+    if (time > 0)
+    {
+        fprintf(file, "Thread utilization: %.2f%%\n", 100.0 * total_busy / (time * threads));
+        fprintf(file, "Throughput: %.1f rows/s\n", (double) counters->rows / time);
+    }
+
+    free(counters);
+}
+
+int stats_write_json(const char* path, double time)
+{
+    stats_counters* counters = (stats_counters*) malloc(sizeof(stats_counters));
+    int threads;
+    int first = 1;
+
+    if (stats_collect(counters, &threads) != 0)
+    {
+        free(counters);
+        return 0;
+    }
+
+    FILE* file = fopen(path, "w");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed on open statistics file %s !\n", path);
+        free(counters);
+        return -1;
+    }
+
+    double total_busy = 0;
+
+    fprintf(file, "{\n  \"time\": %.6f,\n  \"threads\": %d,\n  \"bands\": [\n", time, threads);
+
+    for (int b = 0; b <= STATS_MAX_BANDS; b++)
+    {
+        if (!stats_band_used(counters, b))
+            continue;
+
+        fprintf(file, "%s    { \"band\": %d, \"stages\": {", first ? "" : ",\n", b);
+
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+            double busy = (double) counters->busy[b][s] / 1e9;
+            double span = stats_span(counters, b, s);
+
+            total_busy += busy;
+
+            fprintf(file, "%s \"%s\": { \"busy\": %.6f, \"span\": %.6f, \"idle\": %.6f }", s ? "," : "", stage_names[s], busy, span, (span > busy) ? span - busy : 0);
+        }
+
+        fprintf(file, " }");
+
+        if (counters->accesses[b] > 0)
+            fprintf(file, ", \"read_peak\": %llu, \"write_peak\": %llu, \"accesses\": %llu, \"misses\": %llu, \"hit_ratio\": %.6f", counters->read_peak[b], counters->write_peak[b], counters->accesses[b], counters->misses[b], (double)(counters->accesses[b] - counters->misses[b]) / (double)counters->accesses[b]);
+
+        fprintf(file, " }");
+        first = 0;
+    }
+
+    fprintf(file, "\n  ],\n  \"lock_wait\": %.6f,\n", (double) counters->lock_wait / 1e9);
+    fprintf(file, "  \"utilization\": %.6f,\n", (time > 0) ? total_busy / (time * threads) : 0);
+    fprintf(file, "  \"rows\": %llu,\n  \"rows_per_second\": %.3f\n}\n", counters->rows, (time > 0) ? (double) counters->rows / time : 0);
+
+    fclose(file);
+    free(counters);
+
+    return 0;
+}
@@ -1,580 +1,213 @@
 #include "strips.h"
 
-/* Define the size of last nodes access cache */
-#define ACCESS_CACHE_SIZE 32
-
-/* Define struct to generate nodes in the list */
-typedef struct node
-{
-    int index;          // Index of the strip
-    int access;         // Number of access counter
-    strip* content;     // The strip
-    struct node* next;  // Next node in the list
-
-    #ifdef PARALLEL_PROCESSING
-        omp_lock_t mutex;   // Mutex to lock the node
-    #endif
-} node;
-
-/* Define access cache to nodes of lists */
-typedef struct access_cache
+/* Define struct to generate slots in the ring */
+typedef struct slot
 {
-    node* nodes[ACCESS_CACHE_SIZE]; // Array to store the last accessed nodes
-    int index;                      // Index of the next node to be replaced
-    unsigned long total_access;     // Total number of cache access
-    unsigned long misses;           // Number of cache misses
-
-    #ifdef PARALLEL_PROCESSING
-        omp_lock_t mutex;           // Mutex to lock the cache
-    #endif
-} access_cache;
-
-#ifdef PARALLEL_PROCESSING
-    /**
-     * @brief Acquire a reader lock for the list.
-     * 
-     * @param list The list to acquire the lock.
-     * 
-     * @return void.
-    */
-    void acquire_reader_lock(strip_list* list)
-    {
-        while (1) 
-        {
-            omp_set_lock(&list->mutex);
-
-            if (!list->writer_active) 
-            {
-                list->readers++;
-
-                omp_unset_lock(&list->mutex);
-
-                break;
-            }
-
-            omp_unset_lock(&list->mutex);
-            #pragma omp flush
-        }
-    }
-
-    /**
-     * @brief Release a reader lock for the list.
-     * 
-     * @param list The list to release the lock.
-     * 
-     * @return void.
-    */
-    void release_reader_lock(strip_list* list) 
-    {
-        omp_set_lock(&list->mutex);
-        
-        list->readers--;
-
-        omp_unset_lock(&list->mutex);
-    }
-
-    /**
-     * @brief Acquire a writer lock for the list.
-     * 
-     * @param list The list to acquire the lock.
-     * 
-     * @return void.
-    */
-    void acquire_writer_lock(strip_list* list) 
-    {
-        while (1) 
-        {
-            omp_set_lock(&list->mutex);
-
-            if (list->readers == 0 && !list->writer_active) 
-            {
-                list->writer_active = 1;
-
-                omp_unset_lock(&list->mutex);
-                
-                break;
-            }
-
-            omp_unset_lock(&list->mutex);
-            #pragma omp flush
-        }
-    }
-
-    /**
-     * @brief Release a writer lock for the list.
-     * 
-     * @param list The list to release the lock.
-     * 
-     * @return void.
-    */
-    void release_writer_lock(strip_list* list) 
-    {
-        omp_set_lock(&list->mutex);
-
-        list->writer_active = 0;
-
-        omp_unset_lock(&list->mutex);
-    }
-#endif
-
-node* get_node_cache(access_cache* cache, int index)
-{
-    node* n = NULL;
-
-    cache->total_access++;
-
-    for(int i = 0; i < ACCESS_CACHE_SIZE; i++)
-    {
-        if (cache->nodes[i] && cache->nodes[i]->index == index) 
-        {
-            n = cache->nodes[i];
-            break;
-        }
-    }
-
-    if(!n)
-        cache->misses++;
-
-    return n;
-}
+    atomic_int index;          // Index of the strip
+    atomic_int uses;           // Number of uses not yet released
+    _Atomic(strip) content;    // The strip or NULL if the slot is free
+} slot;
 
 /**
- * @brief Find the parent node of a node in the cache.
+ * @brief Find the slot of a strip in the list.
  * 
- * @param cache The cache to search.
- * @param n The node to find the parent.
+ * @param list The list to search.
+ * @param index The index of the strip to find.
+ * @param content The strip stored on the slot, loaded with acquire semantics.
  * 
- * @return The parent node of the node or NULL if not found.
+ * @return The slot or NULL if the strip is not in the list.
 */
-node* get_node_cache_parent(access_cache* cache, node* n)
+slot* get_slot(strip_list* list, int index, strip* content)
 {
-    node* parent = NULL;
+    if (list->mapping)
+        return NULL;
 
-    cache->total_access++;
+    slot* s = &list->slots[index & (list->capacity - 1)];
 
-    for(int i = 0; i < ACCESS_CACHE_SIZE; i++)
-    {
-        if (cache->nodes[i] && cache->nodes[i]->next == n) 
-        {
-            parent = cache->nodes[i];
-            break;
-        }
-    }
+    /* The index is stored before the content is published, so once a content is seen its index is too */
+    *content = atomic_load_explicit(&s->content, memory_order_acquire);
 
-    if(!parent)
-        cache->misses++;
+    if (*content && atomic_load_explicit(&s->index, memory_order_relaxed) == index)
+        return s;
 
-    return parent;
+    return NULL;
 }
 
 /**
- * @brief Add a node to the cache.
+ * @brief Free the strip of a slot and mark it as free.
  * 
- * @param cache The cache to add the node.
- * @param n The node to add.
+ * @param list The list of the slot.
+ * @param s The slot to free.
  * 
  * @return void.
 */
-void add_node_cache(access_cache* cache, node* n)
+void free_slot(strip_list* list, slot* s)
 {
-    int index = cache->index;
+    strip content = atomic_exchange_explicit(&s->content, NULL, memory_order_acq_rel);
 
-    for(int i = 0; i < ACCESS_CACHE_SIZE; i++)
+    if (content)
     {
-        if (!cache->nodes[i]) 
-        {
-            index = i;
-            break;
-        }
-        else if(cache->nodes[i] == n)
-            return;
+        CPLFree(content);
+        atomic_fetch_sub_explicit(&list->size, 1, memory_order_relaxed);
     }
-
-    cache->nodes[index] = n;
-    
-    if(index == cache->index)
-        cache->index = (cache->index + 1) % ACCESS_CACHE_SIZE;
 }
 
-/**
- * @brief Remove a node from the cache.
- * 
- * @param cache The cache to remove the node.
- * @param n The node to remove.
- * 
- * @return void.
-*/
-void remove_node_cache(access_cache* cache, node* n)
+strip strip_alloc(int size, GDALDataType type)
 {
-    for(int i = 0; i < ACCESS_CACHE_SIZE; i++)
-    {
-        if (cache->nodes[i] == n) 
-        {
-            cache->nodes[i] = NULL;
-            break;
-        }
-    }
+    return (strip) CPLMalloc((size_t)GDALGetDataTypeSizeBytes(type) * (size_t)size);
 }
 
-/**
- * @brief Find a node in the list.
- * 
- * @param list The list to search.
- * @param index The index of the node to find.
- * 
- * @return The node or NULL if not found.
-*/
-node* get_node(strip_list* list, int index)
+strip_list* strip_alloc_list(int max_strips)
 {
-    #ifdef PARALLEL_PROCESSING
-        omp_set_lock(&list->cache->mutex);
-    #endif
+    strip_list* list = (strip_list*) malloc(sizeof(strip_list));
 
-    node* it = get_node_cache(list->cache, index);
+    list->capacity = 1;
 
-    #ifdef PARALLEL_PROCESSING
-        omp_unset_lock(&list->cache->mutex);
-    #endif
-    
-    if(it)
-        return it;
+    while (list->capacity < max_strips)
+        list->capacity *= 2;
 
-    for (it = list->first_node; it; it = it->next)
-        if (it->index == index) 
-            break;
+    list->slots = (slot*) calloc((size_t)list->capacity, sizeof(slot));
 
-    if(it)
-    {
-        #ifdef PARALLEL_PROCESSING
-            omp_set_lock(&list->cache->mutex);
-        #endif
+    list->mapping = NULL;
+    list->line_space = 0;
+    list->mapped_strips = 0;
 
-        add_node_cache(list->cache, it);
-
-        #ifdef PARALLEL_PROCESSING
-            omp_unset_lock(&list->cache->mutex);
-        #endif
+    atomic_init(&list->size, 0);
+    atomic_init(&list->max_size, 0);
+    atomic_init(&list->total_access, 0);
+    atomic_init(&list->misses, 0);
 
+    for (int i = 0; i < list->capacity; i++)
+    {
+        atomic_init(&list->slots[i].index, 0);
+        atomic_init(&list->slots[i].uses, 0);
+        atomic_init(&list->slots[i].content, NULL);
     }
 
-    return it;
-}
-
-/**
- * @brief Find the parent node of a node in the list.
- * 
- * @param list The list to search.
- * @param n The node to find the parent.
- * 
- * @return The parent node of the node or NULL if not found.
-*/
-node* get_node_parent(strip_list* list, node* n)
-{
-    node *parent = list->first_node;
-
-    if(!parent || n == parent)
-        return NULL;
-
-    #ifdef PARALLEL_PROCESSING
-        omp_set_lock(&list->cache->mutex);
-    #endif
-
-    parent = get_node_cache_parent(list->cache, n);
-
-    #ifdef PARALLEL_PROCESSING
-        omp_unset_lock(&list->cache->mutex);
-    #endif
-
-    if(parent)
-        return parent;
-
-    while (parent->next != n)
-        parent = parent->next;
-
-    #ifdef PARALLEL_PROCESSING
-        omp_set_lock(&list->cache->mutex);
-    #endif
-
-    add_node_cache(list->cache, parent);
-
-    #ifdef PARALLEL_PROCESSING
-        omp_unset_lock(&list->cache->mutex);
-    #endif
-
-    return parent;
+    return list;
 }
 
-/**
- * @brief Remove a node from the list.
- * 
- * @param list The list to remove the node.
- * @param n The node to remove.
- * 
- * @return void.
-*/
-void remove_node(strip_list* list, node* n)
+strip_list* strip_map_list(void* mapping, size_t line_space, int strips)
 {
-    node *parent = get_node_parent(list, n);
-
-    if(!parent)
-        list->first_node = n->next;
-    else if (!n->next)
-        parent->next = NULL;  
-    else 
-        parent->next = n->next;
-
-    if (n == list->last_node)
-    {
-        if(parent)
-            list->last_node = parent;
-        else
-            list->last_node = list->first_node;
-    }
-
-    #ifdef PARALLEL_PROCESSING
-        omp_set_lock(&list->cache->mutex);
-    #endif
-
-    remove_node_cache(list->cache, n);
-
-    #ifdef PARALLEL_PROCESSING
-        omp_unset_lock(&list->cache->mutex);
-    #endif
-    
-    list->size--;
+    strip_list* list = (strip_list*) malloc(sizeof(strip_list));
 
-    #ifdef PARALLEL_PROCESSING
-        omp_destroy_lock(&n->mutex);
-    #endif
+    list->capacity = 0;
+    list->slots = NULL;
+    list->mapping = (char*) mapping;
+    list->line_space = line_space;
+    list->mapped_strips = strips;
 
-    CPLFree(*n->content);
+    atomic_init(&list->size, strips);
+    atomic_init(&list->max_size, 0);
+    atomic_init(&list->total_access, 0);
+    atomic_init(&list->misses, 0);
 
-    free(n->content);
-    free(n);
+    return list;
 }
 
-/**
- * @brief Remove all nodes from the list.
- * 
- * @param list The list to remove all nodes.
- * 
- * @return void.
-*/
-void remove_all_node(strip_list* list)
+void strip_free_list(strip_list* list)
 {
-    node* it = list->first_node;
+    for (int i = 0; i < list->capacity; i++)
+        free_slot(list, &list->slots[i]);
 
-    while (it)
-    {
-        node* aux = it;
-
-        it = it->next;
-
-        #ifdef PARALLEL_PROCESSING
-            omp_destroy_lock(&aux->mutex);
-        #endif
-
-        CPLFree(*aux->content);
-
-        free(aux->content);
-        free(aux);
-    }
+    free(list->slots);
+    free(list);
 }
 
-strip strip_alloc(int size)
+int strip_list_add(strip_list* list, int index, strip content)
 {
-    return (strip) CPLMalloc((size_t)((int)sizeof(float) * size));
+    return strip_list_add_shared(list, index, content, 1);
 }
 
-strip_list* strip_alloc_list(void)
+int strip_list_add_shared(strip_list* list, int index, strip content, int uses)
 {
-    strip_list* list = (strip_list*) malloc(sizeof(strip_list));
-
-    list->first_node = NULL;
-    list->size = 0;
-    list->max_size = 0;
-
-    list-> cache = (access_cache*) malloc(sizeof(access_cache));
-
-    list->cache->index = 0;
-    list->cache->misses = 0;
-    list->cache->total_access = 0;
-
-    for (int i = 0; i < ACCESS_CACHE_SIZE; i++)
-        list->cache->nodes[i] = NULL;
-
-    #ifdef PARALLEL_PROCESSING
-        omp_init_lock(&list->cache->mutex);
+    if (list->mapping)
+    {
+        fprintf(stderr, "Strip list is mapped, can not add strip %d !\n", index);
+        return -1;
+    }
 
-        list->readers = 0;
-        list->writer_active = 0;
-        omp_init_lock(&list->mutex);
-    #endif
+    slot* s = &list->slots[index & (list->capacity - 1)];
 
-    return list;
-}
+    if (atomic_load_explicit(&s->content, memory_order_acquire))
+    {
+        fprintf(stderr, "Strip list capacity (%d) exceeded adding strip %d !\n", list->capacity, index);
+        return -1;
+    }
 
-void strip_free_list(strip_list* list)
-{
-    #ifdef PARALLEL_PROCESSING
-        acquire_writer_lock(list);
-    #endif
+    atomic_store_explicit(&s->index, index, memory_order_relaxed);
+    atomic_store_explicit(&s->uses, uses, memory_order_relaxed);
+    atomic_store_explicit(&s->content, content, memory_order_release);
 
-    remove_all_node(list);
+    int size = atomic_fetch_add_explicit(&list->size, 1, memory_order_relaxed) + 1;
+    int max_size = atomic_load_explicit(&list->max_size, memory_order_relaxed);
 
-    #ifdef PARALLEL_PROCESSING
-        omp_destroy_lock(&list->mutex);
-    #endif
+    while (size > max_size && !atomic_compare_exchange_weak_explicit(&list->max_size, &max_size, size, memory_order_relaxed, memory_order_relaxed));
 
-    free(list->cache);
-    free(list);
+    return 0;
 }
 
-void strip_list_add(strip_list* list, int index, strip content)
+void strip_list_release(strip_list* list, int index)
 {
-    node* new_node = (node*) malloc(sizeof(node));
-
-    new_node->index = index;
-    new_node->access = 0;
+    strip content;
 
-    new_node->content = (strip*) malloc(sizeof(strip));
-    *new_node->content = content;
+    slot* s = get_slot(list, index, &content);
 
-    new_node->next = NULL;
-    
-    #ifdef PARALLEL_PROCESSING
-        omp_init_lock(&new_node->mutex);
-
-        acquire_writer_lock(list);
-    #endif
-
-    if(!list->first_node)
-    {
-        list->first_node = new_node;
-        list->last_node = new_node;
-    }
-    else
-    {
-        list->last_node->next = new_node;
-        list->last_node = new_node;
-    }
-
-    list->size++;
-
-    if(list->size > list->max_size)
-        list->max_size = list->size;
-    
-    #ifdef PARALLEL_PROCESSING
-        release_writer_lock(list);
-    #endif
+    if (s && atomic_fetch_sub_explicit(&s->uses, 1, memory_order_acq_rel) == 1)
+        free_slot(list, s);
 }
 
 void strip_list_remove_by_index(strip_list* list, int index)
 {
-    #ifdef PARALLEL_PROCESSING
-        acquire_writer_lock(list);
-    #endif
+    strip content;
 
-    if (list->first_node)
-    {
-        node *n = get_node(list, index);
-
-        if (n)
-            remove_node(list, n);
-    }
+    slot* s = get_slot(list, index, &content);
 
-    #ifdef PARALLEL_PROCESSING
-        release_writer_lock(list);
-    #endif
+    if (s)
+        free_slot(list, s);
 }
 
 strip strip_list_get(strip_list* list, int index)
 {
-    #ifdef PARALLEL_PROCESSING
-        acquire_reader_lock(list);
-    #endif
-
-    strip content = NULL;
+    strip content;
 
-    node* n = get_node(list, index);
+    atomic_fetch_add_explicit(&list->total_access, 1, memory_order_relaxed);
 
-    if(n)
+    if (list->mapping)
     {
-        #ifdef PARALLEL_PROCESSING
-            omp_set_lock(&n->mutex);
-        #endif
+        if (index >= 0 && index < list->mapped_strips)
+            return (strip) (list->mapping + (size_t)index * list->line_space);
 
-        content = *n->content;
-        n->access++;
-
-        #ifdef PARALLEL_PROCESSING
-            omp_unset_lock(&n->mutex);
-        #endif
+        atomic_fetch_add_explicit(&list->misses, 1, memory_order_relaxed);
+        return NULL;
     }
 
-    #ifdef PARALLEL_PROCESSING
-        release_reader_lock(list);
-    #endif
+    slot* s = get_slot(list, index, &content);
+
+    if (!s)
+    {
+        atomic_fetch_add_explicit(&list->misses, 1, memory_order_relaxed);
+        return NULL;
+    }
 
     return content;
 }
 
 int strip_list_get_size(strip_list* list)
 {
-    #ifdef PARALLEL_PROCESSING
-        acquire_reader_lock(list);
-    #endif
-
-    int size = list->size;
-
-    #ifdef PARALLEL_PROCESSING
-        release_reader_lock(list);
-    #endif
-
-    return size;
+    return atomic_load_explicit(&list->size, memory_order_relaxed);
 }
 
 int strip_list_get_max_size(strip_list* list)
 {
-    #ifdef PARALLEL_PROCESSING
-        acquire_reader_lock(list);
-    #endif
-
-    int max_size = list->max_size;
-
-    #ifdef PARALLEL_PROCESSING
-        release_reader_lock(list);
-    #endif
-
-    return max_size;
+    return atomic_load_explicit(&list->max_size, memory_order_relaxed);
 }
 
-int strip_list_get_access(strip_list* list, int index)
+int strip_list_get_uses(strip_list* list, int index)
 {
-    #ifdef PARALLEL_PROCESSING
-        acquire_reader_lock(list);
-    #endif
+    strip content;
 
-    int access = -1;
-
-    node *n = get_node(list, index);
+    slot* s = get_slot(list, index, &content);
     
-    if (n)
-    {
-        #ifdef PARALLEL_PROCESSING
-            omp_set_lock(&n->mutex);
-        #endif
-        
-        access = n->access;
-        
-        #ifdef PARALLEL_PROCESSING
-            omp_unset_lock(&n->mutex);
-        #endif
-    }
-
-    #ifdef PARALLEL_PROCESSING
-        release_reader_lock(list);
-    #endif
-    
-    return access;
-}
\ No newline at end of file
+    return s ? atomic_load_explicit(&s->uses, memory_order_relaxed) : -1;
+}
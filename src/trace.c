@@ -0,0 +1,212 @@
+#include "trace.h"
+
+/* Define struct to store an event of the timeline, in seconds from the start of the recording */
+typedef struct trace_event
+{
+    double start;   // Start of the event
+    double end;     // End of the event
+    int kind;       // Stage of the pipeline or TRACE_LOCK
+    int band;       // Band of the event, 0 for every band at once
+    int thread;     // Thread of the event
+} trace_event;
+
+/* Define struct to store the events of a thread */
+typedef struct trace_buffer
+{
+    trace_event* events;    // Events of the thread, in the order they ended
+    size_t count;           // Number of events
+    size_t capacity;        // Number of events the buffer can hold
+} trace_buffer;
+
+static trace_buffer* buffers = NULL;
+static int buffer_count = 0;
+static int recording = 0;
+static double epoch;
+
+void trace_start(void)
+{
+    #ifdef PARALLEL_PROCESSING
+        buffer_count = omp_get_max_threads();
+    #else
+        buffer_count = 1;
+    #endif
+
+    buffers = (trace_buffer*) calloc((size_t)buffer_count, sizeof(trace_buffer));
+
+    #ifdef MPI_PROCESSING
+        MPI_Barrier(MPI_COMM_WORLD);
+    #endif
+
+    epoch = stats_now();
+    recording = 1;
+}
+
+void trace_add(int kind, int band_index, double start_time, double end_time)
+{
+    int thread = 0;
+
+    if (!recording)
+        return;
+
+    #ifdef PARALLEL_PROCESSING
+        thread = omp_get_thread_num();
+    #endif
+
+    /* Threads of a larger team than the one the buffers were sized to are not recorded */
+    if (thread >= buffer_count)
+        return;
+
+    trace_buffer* buffer = &buffers[thread];
+
+    if (buffer->count == buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : TRACE_INITIAL_EVENTS;
+        trace_event* events = (trace_event*) realloc(buffer->events, capacity * sizeof(trace_event));
+
+        if (events == NULL)
+            return;
+
+        buffer->events = events;
+        buffer->capacity = capacity;
+    }
+
+    buffer->events[buffer->count++] = (trace_event) { .start = start_time - epoch, .end = end_time - epoch, .kind = kind, .band = band_index, .thread = thread };
+}
+
+/**
+ * @brief Write the events of a rank as Chrome trace events, with the names of the rank and its threads.
+ *
+ * @param file The file to write to.
+ * @param events The events.
+ * @param count The number of events.
+ * @param rank The rank of the events.
+ * @param threads The number of threads of the rank.
+ * @param first Is nothing written yet ? Cleared once something is written.
+ *
+ * @return void.
+*/
+void trace_write_events(FILE* file, const trace_event* events, size_t count, int rank, int threads, int* first)
+{
+    fprintf(file, "%s    { \"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": { \"name\": \"Rank %d\" } }", *first ? "" : ",\n", rank, rank);
+    *first = 0;
+
+    for (int t = 0; t < threads; t++)
+        fprintf(file, ",\n    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": { \"name\": \"Thread %d\" } }", rank, t, t);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const trace_event* event = &events[i];
+        const char* name = (event->kind < STAGE_COUNT) ? stats_get_stage_name((process_stage)event->kind) : "lock wait";
+        double duration = (event->end > event->start) ? event->end - event->start : 0;
+
+        fprintf(file, ",\n    { \"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %d, \"args\": { \"band\": %d } }",
+                name, (event->kind < STAGE_COUNT) ? "pipeline" : "lock", event->start * 1e6, duration * 1e6, rank, event->thread, event->band);
+    }
+}
+
+int trace_write(const char* path)
+{
+    size_t count = 0;
+    int rank = 0;
+    int status = 0;
+
+    recording = 0;
+
+    for (int t = 0; t < buffer_count; t++)
+        count += buffers[t].count;
+
+    trace_event* events = (trace_event*) malloc((count ? count : 1) * sizeof(trace_event));
+    size_t offset = 0;
+
+    for (int t = 0; t < buffer_count; t++)
+    {
+        if (buffers[t].count)
+            memcpy(events + offset, buffers[t].events, buffers[t].count * sizeof(trace_event));
+
+        offset += buffers[t].count;
+
+        free(buffers[t].events);
+    }
+
+    free(buffers);
+    buffers = NULL;
+
+    #ifdef MPI_PROCESSING
+        /* The events of every rank are gathered as bytes, the ranks run the same binary */
+        int ranks;
+        int bytes = (int)(count * sizeof(trace_event));
+        int* rank_bytes = NULL;
+        int* rank_offsets = NULL;
+        int* rank_threads = NULL;
+        trace_event* all_events = NULL;
+
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+        if (rank == 0)
+        {
+            rank_bytes = (int*) malloc(sizeof(int) * (size_t)ranks);
+            rank_offsets = (int*) malloc(sizeof(int) * (size_t)ranks);
+            rank_threads = (int*) malloc(sizeof(int) * (size_t)ranks);
+        }
+
+        MPI_Gather(&bytes, 1, MPI_INT, rank_bytes, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Gather(&buffer_count, 1, MPI_INT, rank_threads, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+        if (rank == 0)
+        {
+            int total = 0;
+
+            for (int r = 0; r < ranks; r++)
+            {
+                rank_offsets[r] = total;
+                total += rank_bytes[r];
+            }
+
+            all_events = (trace_event*) malloc(total ? (size_t)total : 1);
+        }
+
+        MPI_Gatherv(events, bytes, MPI_BYTE, all_events, rank_bytes, rank_offsets, MPI_BYTE, 0, MPI_COMM_WORLD);
+    #endif
+
+    if (rank == 0)
+    {
+        FILE* file = fopen(path, "w");
+
+        if (file == NULL)
+        {
+            fprintf(stderr, "Failed on open trace file %s !\n", path);
+            status = -1;
+        }
+        else
+        {
+            int first = 1;
+
+            fprintf(file, "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [\n");
+
+            #ifdef MPI_PROCESSING
+                for (int r = 0; r < ranks; r++)
+                    trace_write_events(file, (const trace_event*)((const char*) all_events + rank_offsets[r]), (size_t)rank_bytes[r] / sizeof(trace_event), r, rank_threads[r], &first);
+            #else
+                trace_write_events(file, events, count, rank, buffer_count, &first);
+            #endif
+
+            fprintf(file, "\n  ]\n}\n");
+            fclose(file);
+
+            fprintf(stdout, "\nTrace written to %s !\n", path);
+        }
+    }
+
+    #ifdef MPI_PROCESSING
+        free(rank_bytes);
+        free(rank_offsets);
+        free(rank_threads);
+        free(all_events);
+    #endif
+
+    free(events);
+    buffer_count = 0;
+
+    return status;
+}
@@ -0,0 +1,381 @@
+#include "tune.h"
+#include "main.h"
+
+/* Candidates of each setting, tried one setting at a time from the defaults */
+static const int chunk_rows_candidates[] = { 16, 32, 64, 128, 256, 512 };
+
+#ifdef PARALLEL_PROCESSING
+    static const int grainsize_candidates[] = { 1, 2, 4, 8, 16, 32 };
+#endif
+
+/* Passes of each candidate, the fastest one is kept so the first pass warms the caches */
+#define TUNE_PASSES 2
+
+void tune_apply(const tune_settings* settings)
+{
+    set_chunk_min_rows(settings->chunk_rows);
+    set_filter_grainsize(settings->grainsize);
+
+    #ifdef PARALLEL_PROCESSING
+        omp_set_num_threads(settings->threads);
+    #endif
+}
+
+/**
+ * @brief Get the model name of the CPU, with the characters that are not letters or digits replaced, so it
+ *        can be part of a profile key.
+ *
+ * @param cpu The model name, "unknown" if it can not be read.
+ * @param size The size of the model name buffer.
+ *
+ * @return void.
+*/
+void tune_get_cpu(char* cpu, size_t size)
+{
+    FILE* file = fopen("/proc/cpuinfo", "r");
+    const char* line;
+
+    snprintf(cpu, size, "unknown");
+
+    if (file == NULL)
+        return;
+
+    while ((line = CPLReadLine(file)) != NULL)
+    {
+        const char* value = strchr(line, ':');
+
+        if (strncmp(line, "model name", 10) == 0 && value != NULL)
+        {
+            while (*++value == ' ');
+
+            snprintf(cpu, size, "%s", value);
+            break;
+        }
+    }
+
+    CPLReadLine(NULL);
+    fclose(file);
+
+    for (char* c = cpu; *c; c++)
+        if (!isalnum((unsigned char)*c))
+            *c = '_';
+}
+
+/**
+ * @brief Get the profile key of a run: the machine, the image shape and the filter, which the best settings
+ *        depend on.
+ *
+ * @param key The key.
+ * @param size The size of the key buffer.
+ * @param input_dataset The input dataset.
+ * @param kern The kernel to be applied.
+ * @param options The processing options.
+ * @param max_threads The threads available to the parallel regions.
+ *
+ * @return void.
+*/
+void tune_get_key(char* key, size_t size, GDALDatasetH input_dataset, const kernel* kern, const process_options* options, int max_threads)
+{
+    char cpu[256];
+    int radius = options->chain ? options->chain->radius : kern->radius;
+    int stages = options->chain ? options->chain->count : 1;
+
+    tune_get_cpu(cpu, sizeof(cpu));
+
+    snprintf(key, size, "cpu=%s;threads=%d;isa=%s;size=%dx%d;bands=%d;type=%s;radius=%d;separable=%d;stages=%d;engine=%s;output=%s",
+             cpu, max_threads, convolve_get_isa(), GDALGetRasterXSize(input_dataset), GDALGetRasterYSize(input_dataset), GDALGetRasterCount(input_dataset),
+             GDALGetDataTypeName(get_strip_type(GDALGetRasterBand(input_dataset, 1))), radius, kern->separable, stages,
+             (options->engine == ENGINE_TILES) ? "tiles" : "strips", GDALGetDataTypeName(options->output_type));
+}
+
+/**
+ * @brief Find the settings of a key in a profile file: lines of a key, the chunk rows, the grainsize and the
+ *        threads separated by spaces. The last line of the key is used, so a new calibration replaces the
+ *        old one.
+ *
+ * @param path The path of the profile file.
+ * @param key The key to find.
+ * @param settings The settings of the key.
+ *
+ * @return int 0 if the key is found, -1 otherwise.
+*/
+int tune_load(const char* path, const char* key, tune_settings* settings)
+{
+    FILE* file = fopen(path, "r");
+    const char* line;
+    int found = -1;
+
+    if (file == NULL)
+        return -1;
+
+    while ((line = CPLReadLine(file)) != NULL)
+    {
+        if (*line == '#' || *line == '\0')
+            continue;
+
+        char** tokens = CSLTokenizeString2(line, " \t", 0);
+
+        if (CSLCount(tokens) == 4 && strcmp(tokens[0], key) == 0 && atoi(tokens[1]) > 0 && atoi(tokens[2]) > 0 && atoi(tokens[3]) > 0)
+        {
+            settings->chunk_rows = atoi(tokens[1]);
+            settings->grainsize = atoi(tokens[2]);
+            settings->threads = atoi(tokens[3]);
+            found = 0;
+        }
+
+        CSLDestroy(tokens);
+    }
+
+    CPLReadLine(NULL);
+    fclose(file);
+
+    return found;
+}
+
+/**
+ * @brief Add the settings of a key to a profile file.
+ *
+ * @param path The path of the profile file.
+ * @param key The key of the settings.
+ * @param settings The settings.
+ *
+ * @return int 0 on success, -1 if the file can not be written.
+*/
+int tune_save(const char* path, const char* key, const tune_settings* settings)
+{
+    FILE* file = fopen(path, "a");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed on open profile file %s !\n", path);
+        return -1;
+    }
+
+    if (ftell(file) == 0)
+        fprintf(file, "# lab4 autotune profile: <key> <chunk rows> <grainsize> <threads>\n");
+
+    fprintf(file, "%s %d %d %d\n", key, settings->chunk_rows, settings->grainsize, settings->threads);
+    fclose(file);
+
+    return 0;
+}
+
+/**
+ * @brief Time the filtering of the sample of the image with some settings, writing to memory.
+ *
+ * @param input_dataset The input dataset.
+ * @param kern The kernel to be applied.
+ * @param options The processing options.
+ * @param sample_rows The rows of the sample, from the first row of the image.
+ * @param settings The settings to time.
+ *
+ * @return double The fastest time of the passes, or a negative value on error.
+*/
+double tune_measure(GDALDatasetH input_dataset, const kernel* kern, const process_options* options, int sample_rows, const tune_settings* settings)
+{
+    int x_size = GDALGetRasterXSize(input_dataset);
+    int y_size = GDALGetRasterYSize(input_dataset);
+    double best = -1;
+
+    tune_apply(settings);
+
+    for (int pass = 0; pass < TUNE_PASSES; pass++)
+    {
+        GDALDatasetH output_dataset = create_output_dataset(input_dataset, TUNE_OUTPUT_PATH, options);
+
+        if (output_dataset == NULL)
+        {
+            fprintf(stderr, "Failed on create calibration dataset !\n");
+            return -1;
+        }
+
+        #ifdef PARALLEL_PROCESSING
+            /* As in process_file, so the calibration times the per-thread handles of the real run instead
+               of handles opened on a dataset whose blocks are not written yet */
+            if (options->parallel_write && dataset_supports_parallel_write(output_dataset))
+            {
+                GDALClose(output_dataset);
+
+                if ((output_dataset = GDALOpen(TUNE_OUTPUT_PATH, GA_Update)) == NULL)
+                {
+                    fprintf(stderr, "Failed on open calibration dataset !\n");
+                    VSIUnlink(TUNE_OUTPUT_PATH);
+                    return -1;
+                }
+            }
+        #endif
+
+        double time = (options->engine == ENGINE_TILES) ? process_dataset_tiles(input_dataset, output_dataset, kern, x_size, y_size, 0, sample_rows, options) : process_dataset(input_dataset, output_dataset, kern, x_size, y_size, 0, sample_rows, options);
+
+        GDALClose(output_dataset);
+        VSIUnlink(TUNE_OUTPUT_PATH);
+
+        if (time < 0)
+            return -1;
+
+        if (best < 0 || time < best)
+            best = time;
+    }
+
+    fprintf(stdout, "\nCalibration chunk rows %d, grainsize %d, threads %d: %f seconds !\n", settings->chunk_rows, settings->grainsize, settings->threads, best);
+
+    return best;
+}
+
+/**
+ * @brief Time a candidate and keep it if it is faster than the best settings so far.
+ *
+ * @param input_dataset The input dataset.
+ * @param kern The kernel to be applied.
+ * @param options The processing options.
+ * @param sample_rows The rows of the sample.
+ * @param candidate The candidate settings.
+ * @param best The best settings so far.
+ * @param best_time The time of the best settings so far.
+ *
+ * @return int 0 on success, -1 on error.
+*/
+int tune_try(GDALDatasetH input_dataset, const kernel* kern, const process_options* options, int sample_rows, tune_settings candidate, tune_settings* best, double* best_time)
+{
+    double time = tune_measure(input_dataset, kern, options, sample_rows, &candidate);
+
+    if (time < 0)
+        return -1;
+
+    if (time < *best_time)
+    {
+        *best = candidate;
+        *best_time = time;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Calibrate the settings on a sample of the image: the thread count first, as it changes the cost
+ *        of the others, then the chunk rows and the grainsize, each one from the best settings so far.
+ *
+ * @param input_dataset The input dataset.
+ * @param kern The kernel to be applied.
+ * @param options The processing options.
+ * @param max_threads The threads available to the parallel regions.
+ * @param best The best settings.
+ *
+ * @return int 0 on success, -1 on error.
+*/
+int tune_calibrate(GDALDatasetH input_dataset, const kernel* kern, const process_options* options, int max_threads, tune_settings* best)
+{
+    int y_size = GDALGetRasterYSize(input_dataset);
+    int sample_rows = (y_size < TUNE_SAMPLE_ROWS) ? y_size : TUNE_SAMPLE_ROWS;
+    tune_settings candidate;
+    double best_time;
+
+    *best = (tune_settings) { .chunk_rows = IO_CHUNK_MIN_ROWS, .grainsize = 1, .threads = max_threads };
+
+    fprintf(stdout, "\nCalibrating on %d rows !\n", sample_rows);
+
+    if ((best_time = tune_measure(input_dataset, kern, options, sample_rows, best)) < 0)
+        return -1;
+
+    #ifdef PARALLEL_PROCESSING
+        for (int threads = 1; threads < max_threads; threads *= 2)
+        {
+            candidate = *best;
+            candidate.threads = threads;
+
+            if (tune_try(input_dataset, kern, options, sample_rows, candidate, best, &best_time) != 0)
+                return -1;
+        }
+    #endif
+
+    int chunk_rows = best->chunk_rows;
+
+    for (size_t i = 0; i < sizeof(chunk_rows_candidates) / sizeof(chunk_rows_candidates[0]); i++)
+    {
+        if (chunk_rows_candidates[i] == chunk_rows)
+            continue;
+
+        candidate = *best;
+        candidate.chunk_rows = chunk_rows_candidates[i];
+
+        if (tune_try(input_dataset, kern, options, sample_rows, candidate, best, &best_time) != 0)
+            return -1;
+    }
+
+    /* Only the filter tasks of the strip engine take the grainsize */
+    #ifdef PARALLEL_PROCESSING
+        if (options->engine == ENGINE_STRIPS)
+        {
+            int grainsize = best->grainsize;
+
+            for (size_t i = 0; i < sizeof(grainsize_candidates) / sizeof(grainsize_candidates[0]); i++)
+            {
+                if (grainsize_candidates[i] == grainsize)
+                    continue;
+
+                candidate = *best;
+                candidate.grainsize = grainsize_candidates[i];
+
+                if (tune_try(input_dataset, kern, options, sample_rows, candidate, best, &best_time) != 0)
+                    return -1;
+            }
+        }
+    #endif
+
+    return 0;
+}
+
+int tune(const char* input_path, const kernel* kern, const process_options* options, const char* profile_path)
+{
+    tune_settings settings = { .chunk_rows = IO_CHUNK_MIN_ROWS, .grainsize = 1, .threads = 1 };
+    int max_threads = 1;
+    int status = 0;
+    int rank = 0;
+
+    #ifdef PARALLEL_PROCESSING
+        max_threads = omp_get_max_threads();
+    #endif
+
+    settings.threads = max_threads;
+
+    #ifdef MPI_PROCESSING
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    #endif
+
+    if (rank == 0)
+    {
+        GDALDatasetH input_dataset = GDALOpen(input_path, GA_ReadOnly);
+        char key[1024];
+
+        if (input_dataset == NULL)
+        {
+            fprintf(stderr, "Failed on open file %s !\n", input_path);
+            status = -1;
+        }
+        else
+        {
+            tune_get_key(key, sizeof(key), input_dataset, kern, options, max_threads);
+
+            if (tune_load(profile_path, key, &settings) == 0)
+                fprintf(stdout, "\nUsing the tuned settings of %s !\n", profile_path);
+            else if ((status = tune_calibrate(input_dataset, kern, options, max_threads, &settings)) == 0)
+                tune_save(profile_path, key, &settings);
+
+            GDALClose(input_dataset);
+        }
+    }
+
+    #ifdef MPI_PROCESSING
+        MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Bcast(&settings, 3, MPI_INT, 0, MPI_COMM_WORLD);
+    #endif
+
+    if (status != 0)
+        return -1;
+
+    tune_apply(&settings);
+
+    fprintf(stdout, "\nTuned settings: chunk rows %d, grainsize %d, threads %d !\n", settings.chunk_rows, settings.grainsize, settings.threads);
+
+    return 0;
+}